@@ -0,0 +1,396 @@
+// Wspólny moduł benchmarku dla programów nowa.c, na3.c, mpi.c, suzuki_kasami.c, maekawa.c i raymond.c.
+// Parametry obciążenia (liczba operacji, czasy sekcji krytycznych i odpoczynku, liczba domów i paserów)
+// można podać w linii poleceń (--ops=N) albo w zmiennych środowiskowych (BENCH_OPS=N);
+// linia poleceń ma pierwszeństwo, a domyślne wartości odpowiadają dotychczasowym stałym #define.
+//
+// Mierzone (dla sekcji krytycznej kradzieży):
+//   - liczba wejść do sekcji krytycznej na sekundę (wszystkie procesy razem),
+//   - opóźnienie synchronizacji: czas od wyjścia jednego procesu z sekcji do wejścia kolejnego,
+//     który już wtedy czekał na ten sam zasób (przy oględzinach: od ostatniego wyjścia, tylko przekazania
+//     do albo od kradzieży; chwile z różnych procesów - na jednym węźle wspólny zegar,
+//     między węzłami zgrany z węzłem procesu 0 przez bench_sync_clocks, z dokładnością do połowy obiegu),
+//   - percentyle p50/p99/p999 czasu oczekiwania (od wysłania żądania do wejścia),
+//   - liczba wysłanych wiadomości protokołu na jedno wejście (w mpi.c razem z ruchem pasera tej operacji).
+// Wyniki są zbierane z procesów przez MPI_Reduce/MPI_Gatherv i wypisywane przez proces 0 jako CSV lub JSON.
+// Czasy oczekiwania i pobytu w sekcji oraz wiadomości według typu trafiają też do rejestru metryk
+// (metrics.h), jeśli program go podłączył (stats->metrics).
+// Z -DBENCH_NO_MPI (symulator sim.c) zostają parametry obciążenia, zapis wejść i wiadomości oraz
+// bench_print_report - bez MPI i rejestru metryk; chwile podaje wtedy zegar wirtualny bench_virtual_now.
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifndef BENCH_NO_MPI // sim.c (symulator bez MPI) nie ma rejestru metryk ani zbierania wyników
+#include <mpi.h>
+#include "metrics.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "walltime.h"
+
+// Parametry obciążenia
+typedef struct {
+    int operations;     // Liczba operacji każdego procesu (--ops, BENCH_OPS)
+    int houses;         // Liczba domów (--houses, BENCH_HOUSES)
+    int fences;         // Liczba paserów (--fences, BENCH_FENCES)
+    int cs_min_us;      // Czas sekcji krytycznej kradzieży w mikrosekundach, losowany z [min, max]
+    int cs_max_us;      //   (--cs-min-us, --cs-max-us, BENCH_CS_MIN_US, BENCH_CS_MAX_US)
+    int fence_min_us;   // Czas sekcji krytycznej pasera (--fence-min-us, --fence-max-us, ...)
+    int fence_max_us;
+    int think_min_us;   // Czas odpoczynku między operacjami (--think-min-us, --think-max-us, ...)
+    int think_max_us;
+    int seed;           // Ziarno generatora (--seed, BENCH_SEED); -1 = losowe jak dotychczas
+    int read_pct;       // Procent operacji, które tylko oglądają dom (--read-pct, BENCH_READ_PCT); 0 = same kradzieże
+    char report[8];     // Format raportu: "csv", "json" albo "" (bez raportu) (--report, BENCH_REPORT)
+} Workload;
+
+// Jedno wejście do sekcji krytycznej
+typedef struct {
+    int resource;         // Zasób (np. dom), o który toczyła się rywalizacja
+    bool shared;          // Wejście współdzielone (oględziny) - false: wyłączne (kradzież)
+    double request_time;  // Chwila wysłania żądania (wall_time)
+    double enter_time;    // Chwila wejścia do sekcji krytycznej
+    double exit_time;     // Chwila wyjścia z sekcji krytycznej
+} CsRecord;
+
+// Statystyki procesu
+typedef struct {
+    CsRecord* records;    // Wejścia do sekcji krytycznej (po jednym na operację)
+    int entries;          // Liczba zapisanych wejść
+    int capacity;
+    long messages_sent;   // Liczba wysłanych wiadomości protokołu
+    double start_time;    // Początek pomiaru (po wspólnej barierze)
+    double end_time;      // Koniec pomiaru (po ostatniej operacji)
+    struct Metrics* metrics; // Rejestr metryk procesu (NULL = bez rejestru)
+} BenchStats;
+
+// Odczytuje parametr: najpierw z linii poleceń (--name=wartość), potem ze zmiennej środowiskowej env_name.
+static const char* bench_option(int argc, char** argv, const char* name, const char* env_name) {
+    size_t len = strlen(name);
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--", 2) == 0 && strncmp(argv[i] + 2, name, len) == 0 && argv[i][2 + len] == '=') {
+            return argv[i] + 3 + len;
+        }
+    }
+    return getenv(env_name);
+}
+
+// Odczytuje parametr liczbowy (lub zwraca wartość domyślną).
+static int bench_int_option(int argc, char** argv, const char* name, const char* env_name, int default_value) {
+    const char* value = bench_option(argc, argv, name, env_name);
+    return value ? atoi(value) : default_value;
+}
+
+// Wypełnia parametry obciążenia. Wartości domyślne pochodzą ze stałych programu.
+static void workload_init(Workload* w, int argc, char** argv, int default_operations, int default_houses, int default_fences) {
+    w->operations = bench_int_option(argc, argv, "ops", "BENCH_OPS", default_operations);
+    w->houses = bench_int_option(argc, argv, "houses", "BENCH_HOUSES", default_houses);
+    w->fences = bench_int_option(argc, argv, "fences", "BENCH_FENCES", default_fences);
+    w->cs_min_us = bench_int_option(argc, argv, "cs-min-us", "BENCH_CS_MIN_US", 50000);
+    w->cs_max_us = bench_int_option(argc, argv, "cs-max-us", "BENCH_CS_MAX_US", 149000);
+    w->fence_min_us = bench_int_option(argc, argv, "fence-min-us", "BENCH_FENCE_MIN_US", 30000);
+    w->fence_max_us = bench_int_option(argc, argv, "fence-max-us", "BENCH_FENCE_MAX_US", 109000);
+    w->think_min_us = bench_int_option(argc, argv, "think-min-us", "BENCH_THINK_MIN_US", 0);
+    w->think_max_us = bench_int_option(argc, argv, "think-max-us", "BENCH_THINK_MAX_US", 49000);
+    w->seed = bench_int_option(argc, argv, "seed", "BENCH_SEED", -1);
+    w->read_pct = bench_int_option(argc, argv, "read-pct", "BENCH_READ_PCT", 0);
+
+    const char* report = bench_option(argc, argv, "report", "BENCH_REPORT");
+    snprintf(w->report, sizeof(w->report), "%s", report ? report : "");
+
+    if (w->houses < 1) w->houses = 1;
+    if (w->fences < 1) w->fences = 1;
+}
+
+// Losuje, czy operacja tylko ogląda dom (sekcja współdzielona). Przy read_pct = 0 nie zużywa liczby
+// losowej, więc obciążenie z tym samym ziarnem jest takie jak dotychczas.
+static inline bool workload_random_read(const Workload* w) {
+    return w->read_pct > 0 && rand() % 100 < w->read_pct;
+}
+
+// Losuje czas (w mikrosekundach) z przedziału [min_us, max_us].
+static int workload_random_us(int min_us, int max_us) {
+    if (max_us <= min_us) return min_us;
+    return min_us + rand() % (max_us - min_us + 1);
+}
+
+#ifdef BENCH_NO_MPI
+static double bench_virtual_now = 0.0; // Zegar symulatora (sekundy) - ustawia go sim.c przed każdym zdarzeniem
+#endif
+
+// Bieżąca chwila pomiaru: wall_time, a w symulatorze jego zegar wirtualny.
+static inline double bench_now(void) {
+#ifdef BENCH_NO_MPI
+    return bench_virtual_now;
+#else
+    return wall_time();
+#endif
+}
+
+static void bench_init(BenchStats* stats, int capacity) {
+    stats->records = malloc((capacity > 0 ? capacity : 1) * sizeof(CsRecord));
+    stats->entries = 0;
+    stats->capacity = capacity;
+    stats->messages_sent = 0;
+    stats->start_time = stats->end_time = 0.0;
+    stats->metrics = NULL;
+}
+
+static void bench_free(BenchStats* stats) {
+    free(stats->records);
+}
+
+#ifndef BENCH_NO_MPI
+// Przesunięcie zegara każdego węzła względem węzła procesu 0 (algorytm Cristiana). Procesy jednego węzła
+// czytają ten sam CLOCK_REALTIME, więc mierzą tylko liderzy węzłów (MPI_COMM_TYPE_SHARED): proces 0 wysyła
+// każdemu BENCH_CLOCK_ROUNDS zapytań, odpowiedź niesie czas lidera, a z próbki o najkrótszym obiegu
+// przesunięcie = środek obiegu u procesu 0 minus odczytany czas (błąd do połowy tego obiegu). Lider
+// rozsyła je w węźle; na węźle procesu 0 zostaje dokładne 0. Na osobnych komunikatorach, bo odbiory
+// protokołu (MPI_ANY_SOURCE) są już wystawione.
+#ifndef BENCH_CLOCK_ROUNDS
+#define BENCH_CLOCK_ROUNDS 8
+#endif
+
+static void bench_sync_clocks(void) {
+    int rank, node_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm node, leaders;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &node_rank);
+    MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank, &leaders);
+
+    double offset = 0.0;
+    if (leaders != MPI_COMM_NULL) {
+        int leader, num_leaders;
+        MPI_Comm_rank(leaders, &leader);
+        MPI_Comm_size(leaders, &num_leaders);
+        if (leader == 0) {
+            for (int r = 1; r < num_leaders; r++) {
+                double best_rtt = -1.0, best_offset = 0.0;
+                for (int k = 0; k < BENCH_CLOCK_ROUNDS; k++) {
+                    double remote;
+                    double t0 = wall_time_local();
+                    MPI_Send(&t0, 1, MPI_DOUBLE, r, 0, leaders);
+                    MPI_Recv(&remote, 1, MPI_DOUBLE, r, 0, leaders, MPI_STATUS_IGNORE);
+                    double t1 = wall_time_local();
+                    if (best_rtt < 0.0 || t1 - t0 < best_rtt) {
+                        best_rtt = t1 - t0;
+                        best_offset = (t0 + t1) / 2.0 - remote;
+                    }
+                }
+                MPI_Send(&best_offset, 1, MPI_DOUBLE, r, 0, leaders);
+            }
+        } else {
+            for (int k = 0; k < BENCH_CLOCK_ROUNDS; k++) {
+                double ping;
+                MPI_Recv(&ping, 1, MPI_DOUBLE, 0, 0, leaders, MPI_STATUS_IGNORE);
+                double now = wall_time_local();
+                MPI_Send(&now, 1, MPI_DOUBLE, 0, 0, leaders);
+            }
+            MPI_Recv(&offset, 1, MPI_DOUBLE, 0, 0, leaders, MPI_STATUS_IGNORE);
+        }
+        MPI_Comm_free(&leaders);
+    }
+    MPI_Bcast(&offset, 1, MPI_DOUBLE, 0, node);
+    MPI_Comm_free(&node);
+    wall_time_offset = offset;
+}
+
+// Początek pomiaru: zegary zgrane z procesem 0, wszystkie procesy startują razem.
+static void bench_start(BenchStats* stats) {
+    bench_sync_clocks();
+    MPI_Barrier(MPI_COMM_WORLD);
+    stats->start_time = wall_time();
+}
+#endif
+
+// Proces wysyła żądanie dostępu do zasobu resource (shared: oględziny razem z innymi oglądającymi).
+static void bench_request(BenchStats* stats, int resource, bool shared) {
+    if (stats->entries >= stats->capacity) return;
+    stats->records[stats->entries].resource = resource;
+    stats->records[stats->entries].shared = shared;
+    stats->records[stats->entries].request_time = bench_now();
+}
+
+// Proces wszedł do sekcji krytycznej.
+static void bench_enter(BenchStats* stats) {
+    if (stats->entries >= stats->capacity) return;
+    CsRecord* record = &stats->records[stats->entries];
+    record->enter_time = bench_now();
+#ifndef BENCH_NO_MPI
+    if (stats->metrics) metrics_add_time(&stats->metrics->wait_us, record->enter_time - record->request_time);
+#endif
+}
+
+// Proces wyszedł z sekcji krytycznej.
+static void bench_exit(BenchStats* stats) {
+    if (stats->entries >= stats->capacity) return;
+    CsRecord* record = &stats->records[stats->entries];
+    record->exit_time = bench_now();
+#ifndef BENCH_NO_MPI
+    if (stats->metrics) metrics_add_time(&stats->metrics->cs_us, record->exit_time - record->enter_time);
+#endif
+    stats->entries++;
+}
+
+#ifndef BENCH_NO_MPI
+// Zlicza w rejestrze metryk zdarzenie type i doklejone do niego zdarzenia piggyback (maska 1 << typ).
+static inline void bench_count_events(MetricCounter* counters, int type, int piggyback) {
+    metrics_count(counters, type);
+    for (int t = 0; piggyback >> t; t++) {
+        if (piggyback & (1 << t)) metrics_count(counters, t);
+    }
+}
+#endif
+
+// Wysłano wiadomość protokołu (stats == NULL: wiadomość poza pomiarem).
+static inline void bench_message_sent(BenchStats* stats, int type, int piggyback) {
+    if (!stats) return;
+    stats->messages_sent++;
+#ifndef BENCH_NO_MPI
+    if (stats->metrics) bench_count_events(stats->metrics->sent, type, piggyback);
+#else
+    (void)type;
+    (void)piggyback;
+#endif
+}
+
+// Obsłużono odebraną wiadomość protokołu.
+static inline void bench_message_received(BenchStats* stats, int type, int piggyback) {
+#ifndef BENCH_NO_MPI
+    if (stats && stats->metrics) bench_count_events(stats->metrics->received, type, piggyback);
+#else
+    (void)stats;
+    (void)type;
+    (void)piggyback;
+#endif
+}
+
+// Koniec pomiaru (po ostatniej operacji procesu).
+static inline void bench_finish(BenchStats* stats) {
+    stats->end_time = bench_now();
+}
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static int compare_cs_records(const void* a, const void* b) {
+    const CsRecord* r_a = a;
+    const CsRecord* r_b = b;
+    if (r_a->resource != r_b->resource) return r_a->resource - r_b->resource;
+    return compare_doubles(&r_a->enter_time, &r_b->enter_time);
+}
+
+// Percentyl p (0..1) z posortowanej tablicy.
+static double percentile(const double* sorted, int n, double p) {
+    if (n == 0) return 0.0;
+    int idx = (int)(p * n + 0.999999) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return sorted[idx];
+}
+
+// Liczy i wypisuje raport z wejść wszystkich procesów (all jest sortowane w miejscu).
+static void bench_print_report(CsRecord* all, int total_records, long total_messages, double max_elapsed,
+                               const Workload* w, const char* program, int num_procs) {
+    double* waits = malloc((total_records > 0 ? total_records : 1) * sizeof(double));
+    for (int i = 0; i < total_records; i++) {
+        waits[i] = all[i].enter_time - all[i].request_time;
+    }
+    qsort(waits, total_records, sizeof(double), compare_doubles);
+
+    // Opóźnienie synchronizacji: przekazanie zasobu czekającemu następcy, liczone od najpóźniejszego wyjścia
+    // spośród wcześniejszych wejść (oglądający nakładają się w czasie). Wejście oglądającego, gdy inni
+    // oglądający jeszcze są w środku, nie jest przekazaniem; przekazania między samymi oglądającymi też
+    // pomijamy - liczą się tylko te do albo od kradzieży. Ujemny odstęp to tylko błąd zgrania zegarów
+    // różnych węzłów (wyłączność wykluczyła nakładanie) - liczymy go jako zero.
+    qsort(all, total_records, sizeof(CsRecord), compare_cs_records);
+    double sync_delay_sum = 0.0;
+    int sync_delay_samples = 0;
+    double last_exit = 0.0;   // Najpóźniejsze wyjście spośród wcześniejszych wejść do zasobu
+    bool last_shared = false; // Czy to wyjście było oglądającego
+    for (int i = 0; i < total_records; i++) {
+        if (i == 0 || all[i].resource != all[i - 1].resource) {
+            last_exit = all[i].exit_time;
+            last_shared = all[i].shared;
+            continue;
+        }
+        double gap = all[i].enter_time - last_exit;
+        if (!(all[i].shared && last_shared) && all[i].request_time < last_exit) {
+            sync_delay_sum += gap > 0 ? gap : 0.0;
+            sync_delay_samples++;
+        }
+        if (all[i].exit_time > last_exit) {
+            last_exit = all[i].exit_time;
+            last_shared = all[i].shared;
+        }
+    }
+
+    double entries_per_sec = max_elapsed > 0 ? total_records / max_elapsed : 0.0;
+    double sync_delay_ms = sync_delay_samples > 0 ? 1000.0 * sync_delay_sum / sync_delay_samples : 0.0;
+    double messages_per_entry = total_records > 0 ? (double)total_messages / total_records : 0.0;
+    double p50 = 1000.0 * percentile(waits, total_records, 0.50);
+    double p99 = 1000.0 * percentile(waits, total_records, 0.99);
+    double p999 = 1000.0 * percentile(waits, total_records, 0.999);
+
+    if (strcmp(w->report, "json") == 0) {
+        printf("{\"program\": \"%s\", \"procs\": %d, \"ops\": %d, \"houses\": %d, \"fences\": %d, "
+               "\"cs_us\": [%d, %d], \"think_us\": [%d, %d], \"entries\": %ld, \"elapsed_s\": %.6f, "
+               "\"entries_per_sec\": %.3f, \"sync_delay_ms\": %.3f, \"wait_p50_ms\": %.3f, "
+               "\"wait_p99_ms\": %.3f, \"wait_p999_ms\": %.3f, \"messages_per_entry\": %.3f}\n",
+               program, num_procs, w->operations, w->houses, w->fences,
+               w->cs_min_us, w->cs_max_us, w->think_min_us, w->think_max_us, (long)total_records, max_elapsed,
+               entries_per_sec, sync_delay_ms, p50, p99, p999, messages_per_entry);
+    } else {
+        printf("program,procs,ops,houses,fences,cs_min_us,cs_max_us,think_min_us,think_max_us,entries,elapsed_s,"
+               "entries_per_sec,sync_delay_ms,wait_p50_ms,wait_p99_ms,wait_p999_ms,messages_per_entry\n");
+        printf("%s,%d,%d,%d,%d,%d,%d,%d,%d,%ld,%.6f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n",
+               program, num_procs, w->operations, w->houses, w->fences,
+               w->cs_min_us, w->cs_max_us, w->think_min_us, w->think_max_us, (long)total_records, max_elapsed,
+               entries_per_sec, sync_delay_ms, p50, p99, p999, messages_per_entry);
+    }
+    fflush(stdout);
+
+    free(waits);
+}
+
+#ifndef BENCH_NO_MPI
+// Zbiera statystyki ze wszystkich procesów i wypisuje raport (proces 0). Funkcja zbiorowa.
+static void bench_report(BenchStats* stats, const Workload* w, const char* program, int my_rank, int num_procs) {
+    if (w->report[0] == '\0') return;
+
+    // Liczniki: suma wejść i wiadomości, najdłuższy czas pracy
+    long local_counts[2] = {stats->entries, stats->messages_sent};
+    long total_counts[2];
+    MPI_Reduce(local_counts, total_counts, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    double elapsed = stats->end_time - stats->start_time;
+    double max_elapsed;
+    MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // Wszystkie wejścia trafiają do procesu 0 (percentyle i opóźnienie synchronizacji)
+    int counts[num_procs], displs[num_procs];
+    int local_bytes = stats->entries * (int)sizeof(CsRecord);
+    MPI_Gather(&local_bytes, 1, MPI_INT, counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    CsRecord* all = NULL;
+    int total_records = 0;
+    if (my_rank == 0) {
+        int offset = 0;
+        for (int i = 0; i < num_procs; i++) {
+            displs[i] = offset;
+            offset += counts[i];
+        }
+        total_records = offset / (int)sizeof(CsRecord);
+        all = malloc((total_records > 0 ? total_records : 1) * sizeof(CsRecord));
+    }
+    MPI_Gatherv(stats->records, local_bytes, MPI_BYTE, all, counts, displs, MPI_BYTE, 0, MPI_COMM_WORLD);
+    if (my_rank != 0) return;
+
+    bench_print_report(all, total_records, total_counts[1], max_elapsed, w, program, num_procs);
+    free(all);
+}
+#endif
+
+#endif
@@ -0,0 +1,52 @@
+#!/bin/sh
+# Uruchamia nowa.c, na3.c (z blokadą Lamporta, MCS i hierarchiczną), mpi.c (rozproszony i z serwerem blokad)
+# oraz suzuki_kasami.c, maekawa.c i raymond.c z tym samym obciążeniem i zbiera wyniki w jednym pliku CSV.
+#
+# Użycie: ./bench.sh [liczby procesów...] [-- parametry obciążenia]
+#   np.:  ./bench.sh 2 4 8 -- --ops=20 --cs-min-us=1000 --cs-max-us=5000 --think-max-us=2000 --seed=1
+# Domyślne liczby domów i paserów różnią się między programami, więc skrypt podaje wszystkim te same
+# (BENCH_HOUSES, BENCH_FENCES - przekazywane przez mpirun -x; --houses/--fences w parametrach mają pierwszeństwo).
+# Tylko mpi.c ma etap pasera - u pozostałych kolumna fences tylko powtarza parametr.
+#
+# Zmienne: MPICC (domyślnie mpicc), MPIRUN (domyślnie mpirun), MPIRUN_FLAGS, OUT (domyślnie bench.csv),
+#          BENCH_HOUSES (domyślnie 3), BENCH_FENCES (domyślnie 7).
+set -e
+
+MPICC=${MPICC:-mpicc}
+MPIRUN=${MPIRUN:-mpirun}
+OUT=${OUT:-bench.csv}
+BUILD_DIR=${BUILD_DIR:-/tmp/bench_build}
+BENCH_HOUSES=${BENCH_HOUSES:-3}
+BENCH_FENCES=${BENCH_FENCES:-7}
+export BENCH_HOUSES BENCH_FENCES
+
+PROCS=""
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    PROCS="$PROCS $1"
+    shift
+done
+[ "$1" = "--" ] && shift
+[ -z "$PROCS" ] && PROCS="2 4 8"
+
+mkdir -p "$BUILD_DIR"
+for prog in nowa na3 mpi suzuki_kasami maekawa raymond; do
+    "$MPICC" -O2 -o "$BUILD_DIR/$prog" "$prog.c"
+done
+
+: > "$OUT"
+for np in $PROCS; do
+    for run in nowa na3 na3+mcs na3+hier mpi mpi+servers mpi+adaptive suzuki_kasami maekawa raymond; do
+        case "$run" in
+            na3+mcs) prog=na3; lock=--lock=mcs ;;
+            na3+hier) prog=na3; lock=--lock=hier ;;
+            mpi+servers) prog=mpi; lock=--servers=1 ;;
+            mpi+adaptive) prog=mpi; lock=--adaptive=1 ;;
+            *) prog=$run; lock= ;;
+        esac
+        # Logi procesów są pomijane; zostaje tylko raport CSV procesu 0 (nagłówek raz na plik)
+        "$MPIRUN" $MPIRUN_FLAGS -x BENCH_HOUSES -x BENCH_FENCES -np "$np" "$BUILD_DIR/$prog" $lock "$@" --report=csv | grep -v '^--- Proces' |
+            if [ -s "$OUT" ]; then grep -v '^program,'; else cat; fi >> "$OUT"
+    done
+done
+
+cat "$OUT"
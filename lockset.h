@@ -0,0 +1,1328 @@
+// Zbiór blokad procesu - wspólne maszyny stanów protokołów wzajemnego wykluczania dla mpi.c, na3.c, nowa.c
+// i symulatora sim.c. Programy zostają cienkimi sterownikami: ustawiają tryb zbioru, a potem w pętli
+// obciążenia wołają lock_try_acquire / lock_wait / lock_release.
+//   - domy 0..houses-1 z kolejkami Lamporta (czytelnicy-pisarze: oglądający wchodzą razem), opcjonalnie
+//     z dzierżawą (lease) albo z adaptacyjnym przełączaniem domu na token,
+//   - paserzy (RESOURCE_FENCE) jako pula P tokenów,
+//   - tryb serwerów blokad (zasoby przydzielają procesy-serwery),
+//   - tryb Ricarta-Agrawali z optymalizacją Roucairola-Carvalho (lock_set_use_ra - nowa.c).
+// Wiadomości idą przez wymienny transport (LockTransport): w programach MPI to MpiTransport (na dole pliku,
+// razem z wykrywaniem zakończenia w LockRuntime), w symulatorze - kolejka zdarzeń sim.c. Z -DLOCKSET_NO_MPI
+// zostaje sam kod protokołów, bez MPI, rejestru metryk i śladu.
+#ifndef LOCKSET_H
+#define LOCKSET_H
+
+#ifdef LOCKSET_NO_MPI
+#define BENCH_NO_MPI
+#define TRACE_NO_MPI
+#else
+#include <mpi.h>
+#include <unistd.h>
+#include "metrics.h"
+#include "transport.h"
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "queue.h"
+#include "bench.h"
+#include "trace.h"
+
+#define FENCE_TOKEN_TAG 1     // Tag ładunku tokenu pasera (wysyłany razem z MSG_FENCE_TOKEN)
+#define HOUSE_TOKEN_TAG 2     // Tag ładunku tokenu domu i SWITCH_LAMPORT (tablica served)
+
+// Typy wiadomości
+typedef enum {
+    MSG_STEAL_REQ,
+    MSG_STEAL_REL,
+    MSG_STEAL_ACK,   // Oglądający ten sam dom: późniejsza wiadomość do warunku 2; Ricart-Agrawala: zgoda
+    MSG_FENCE_REQ,   // Żądanie dowolnego wolnego pasera (z numerem żądania)
+    MSG_FENCE_TOKEN, // Przekazanie tokenu pasera (ładunek: ID pasera, liczba użyć, obsłużone żądania)
+    MSG_GRANT,       // Tryb serwerów: przydział domu (house_id) albo pasera (request_number = ID pasera)
+    MSG_FENCE_REL,   // Tryb serwerów: zwolnienie pasera (serwer pamięta, którego)
+    MSG_HOUSE_TOKEN, // Tryb adaptacyjny: przekazanie tokenu domu (ładunek: tablica served)
+    MSG_SWITCH_TOKEN, // Dom przechodzi na token, który ma nadawca (zamiast jego STEAL_REL)
+    MSG_SWITCH_LAMPORT, // Dom wraca do kolejki Lamporta - tokenu już nie ma (ładunek: tablica served)
+    MSG_TERMINATE    // Nadawca nie będzie już kradł (doklejane do jego ostatniego STEAL_REL)
+} MessageType;
+
+// Struktura wiadomości. Jedna wiadomość może nieść kilka zdarzeń (np. STEAL_REL + FENCE_REQ):
+// pierwsze w type, kolejne w masce piggyback, ze wspólnym timestampem.
+typedef struct {
+    MessageType type;
+    int timestamp;
+    int sender_rank;
+    int house_id;    // Dom, którego dotyczy STEAL_REQ/STEAL_REL (-1 dla pozostałych typów)
+    int request_number; // Numer żądania pasera (FENCE_REQ)
+    int piggyback;   // Doklejone zdarzenia: maska 1 << MessageType
+    AccessMode mode; // Tryb STEAL_REQ/STEAL_REL
+    int epoch;       // Epoka protokołu domu (HOUSE_TOKEN, SWITCH_TOKEN, SWITCH_LAMPORT)
+} Message;
+
+// Funkcja pomocnicza do zwracania nazwy typu wiadomości
+static const char* get_message_type_name(MessageType type) {
+    switch (type) {
+        case MSG_STEAL_REQ: return "żądanie KRADZIEŻY (STEAL_REQ)";
+        case MSG_STEAL_REL: return "zwolnienie KRADZIEŻY (STEAL_REL)";
+        case MSG_STEAL_ACK: return "potwierdzenie (STEAL_ACK)";
+        case MSG_FENCE_REQ: return "żądanie PASERA (FENCE_REQ)";
+        case MSG_FENCE_TOKEN: return "token PASERA (FENCE_TOKEN)";
+        case MSG_GRANT: return "PRZYDZIAŁ od serwera (GRANT)";
+        case MSG_FENCE_REL: return "zwolnienie PASERA (FENCE_REL)";
+        case MSG_HOUSE_TOKEN: return "token DOMU (HOUSE_TOKEN)";
+        case MSG_SWITCH_TOKEN: return "dom na TOKEN (SWITCH_TOKEN)";
+        case MSG_SWITCH_LAMPORT: return "dom na LAMPORTA (SWITCH_LAMPORT)";
+        case MSG_TERMINATE: return "ZAKOŃCZENIE PRACY (TERMINATE)";
+        default: return "NIEZNANY TYP";
+    }
+}
+
+// Transport zbioru blokad. Kanały muszą być FIFO między każdą parą procesów (warunek 2 Lamporta i zgody
+// Ricarta-Agrawali na tym polegają); ładunek może wyprzedzić swój nagłówek - odbiorca czeka na niego
+// (recv_payload) dopiero po odebraniu nagłówka.
+typedef struct {
+    void* ctx;
+    // Paczka wiadomości jednego kroku protokołu (co najwyżej jedna na odbiorcę)
+    void (*send)(void* ctx, const Message* msgs, const int* targets, int count);
+    bool (*try_recv)(void* ctx, Message* msg);  // Wiadomość, która już przyszła (false = nic nie ma)
+    void (*recv)(void* ctx, Message* msg);      // Czeka na wiadomość
+    void (*send_payload)(void* ctx, const int* data, int count, int target, int tag);
+    void (*recv_payload)(void* ctx, int* data, int count, int source, int tag);
+} LockTransport;
+
+// Sklejanie zdarzeń jednego kroku protokołu: najwyżej jedna wiadomość na odbiorcę, wysyłane przy outbox_flush.
+typedef struct {
+    Message* pending;
+    bool* has_pending;
+    int* pending_targets;  // Odbiorcy czekających wiadomości w kolejności dodania (flush nie przegląda wszystkich N)
+    int pending_count;
+    Message* batch;        // Paczka dla transportu (wiadomości i ich odbiorcy)
+    int* targets;
+    int num_procs;
+} OutBox;
+
+static void outbox_init(OutBox* box, int num_procs) {
+    box->pending = malloc(num_procs * sizeof(Message));
+    box->has_pending = calloc(num_procs, sizeof(bool));
+    box->pending_targets = malloc(num_procs * sizeof(int));
+    box->pending_count = 0;
+    box->batch = malloc(num_procs * sizeof(Message));
+    box->targets = malloc(num_procs * sizeof(int));
+    box->num_procs = num_procs;
+}
+
+// Zdarzenie da się dokleić, jeśli go jeszcze nie ma w wiadomości i nie potrzebuje zajętego pola (dom).
+// Wyjątek: zgoda i żądanie o ten sam dom (Ricart-Agrawala oddaje zgodę i od razu prosi o nią z powrotem).
+static bool outbox_can_merge(const Message* pending, const Message* msg) {
+    int events = (1 << pending->type) | pending->piggyback;
+    if (events & (1 << msg->type)) return false;
+    if (msg->house_id == -1 || pending->house_id == -1) return true;
+    int request_and_ack = (1 << MSG_STEAL_REQ) | (1 << MSG_STEAL_ACK);
+    return msg->house_id == pending->house_id && ((events | (1 << msg->type)) & ~request_and_ack) == 0;
+}
+
+// Koniec kroku: wszystkie zebrane wiadomości jedną paczką do transportu (stats == NULL: poza pomiarem).
+static void outbox_flush(OutBox* box, const LockTransport* transport, BenchStats* stats, Trace* trace) {
+    int count = 0;
+    for (int k = 0; k < box->pending_count; k++) {
+        int j = box->pending_targets[k];
+        box->batch[count] = box->pending[j];
+        box->targets[count++] = j;
+        box->has_pending[j] = false;
+        bench_message_sent(stats, box->pending[j].type, box->pending[j].piggyback);
+        trace_event(trace, TRACE_SEND, box->pending[j].timestamp, j, box->pending[j].type, box->pending[j].house_id);
+    }
+    box->pending_count = 0;
+    if (count > 0) transport->send(transport->ctx, box->batch, box->targets, count);
+}
+
+// Dodaje zdarzenie msg dla procesu target - dokleja je do czekającej wiadomości, jeśli się da; jeśli nie,
+// najpierw wysyła wszystko, co zebrano (kolejność zdarzeń do każdego odbiorcy zostaje zachowana).
+static void outbox_add(OutBox* box, const Message* msg, int target, const LockTransport* transport, BenchStats* stats,
+                       Trace* trace) {
+    Message* pending = &box->pending[target];
+    if (box->has_pending[target]) {
+        if (outbox_can_merge(pending, msg)) {
+            int events = (1 << pending->type) | pending->piggyback;
+            pending->piggyback |= 1 << msg->type;
+            if (msg->house_id != -1 && (pending->house_id == -1 || msg->type == MSG_STEAL_REQ)) {
+                pending->house_id = msg->house_id;
+                pending->mode = msg->mode;
+                pending->epoch = msg->epoch;
+            }
+            if (msg->type == MSG_FENCE_REQ) pending->request_number = msg->request_number;
+            // Timestamp STEAL_REQ to jego miejsce w kolejce; pozostałym wystarczy późniejszy
+            if (msg->type == MSG_STEAL_REQ) {
+                pending->timestamp = msg->timestamp;
+            } else if (!(events & (1 << MSG_STEAL_REQ))) {
+                pending->timestamp = max(pending->timestamp, msg->timestamp);
+            }
+            return;
+        }
+        outbox_flush(box, transport, stats, trace);
+    }
+    *pending = *msg;
+    box->has_pending[target] = true;
+    box->pending_targets[box->pending_count++] = target;
+}
+
+static void outbox_free(OutBox* box) {
+    free(box->pending);
+    free(box->has_pending);
+    free(box->pending_targets);
+    free(box->batch);
+    free(box->targets);
+}
+
+// Paserzy jako pula P tokenów (k-wzajemne wykluczanie: Suzuki-Kasami z P tokenami).
+// Token f to paser f - w sekcji pasera jest tylko ten, kto trzyma token, więc naraz najwyżej P
+// procesów, każdy u innego pasera. Wejście kosztuje 0 wiadomości (wolny token na miejscu)
+// albo N-1 FENCE_REQ + 1 przekazanie tokenu; nie ma FENCE_ACK ani rozgłaszanego FENCE_REL.
+typedef struct {
+    int num_fences, num_procs, my_rank;
+    int* request_numbers;  // RN[i]: najwyższy znany numer żądania procesu i
+    int* served;           // Najwyższy obsłużony numer żądania procesu i (scalany z każdym tokenem)
+    bool* held;            // held[f]: czy mam token pasera f
+    int* uses;             // uses[f]: ile razy skorzystano z pasera f (przenoszone z tokenem)
+    int in_use;            // Paser, z którego korzystam (-1 = żaden)
+    bool waiting;          // Czy czekam na token
+} FencePool;
+
+static inline void fence_pool_init(FencePool* pool, int num_fences, int num_procs, int my_rank) {
+    pool->num_fences = num_fences;
+    pool->num_procs = num_procs;
+    pool->my_rank = my_rank;
+    pool->request_numbers = calloc(num_procs, sizeof(int));
+    pool->served = calloc(num_procs, sizeof(int));
+    pool->held = malloc((num_fences > 0 ? num_fences : 1) * sizeof(bool));
+    pool->uses = calloc(num_fences > 0 ? num_fences : 1, sizeof(int));
+    for (int f = 0; f < num_fences; f++) {
+        pool->held[f] = (f % num_procs == my_rank); // Tokeny rozdane po kolei
+    }
+    pool->in_use = -1;
+    pool->waiting = false;
+}
+
+static inline void fence_pool_free(FencePool* pool) {
+    free(pool->request_numbers);
+    free(pool->served);
+    free(pool->held);
+    free(pool->uses);
+}
+
+// Wolny token z najmniejszą liczbą użyć (równoważenie obciążenia paserów) albo -1.
+static int fence_take_idle(FencePool* pool) {
+    int best = -1;
+    for (int f = 0; f < pool->num_fences; f++) {
+        if (pool->held[f] && f != pool->in_use && (best == -1 || pool->uses[f] < pool->uses[best])) {
+            best = f;
+        }
+    }
+    return best;
+}
+
+// Następny (po mnie, po kolei) proces z nieobsłużonym żądaniem albo -1.
+static int fence_next_waiting(FencePool* pool) {
+    for (int k = 1; k < pool->num_procs; k++) {
+        int i = (pool->my_rank + k) % pool->num_procs;
+        if (pool->request_numbers[i] > pool->served[i]) return i;
+    }
+    return -1;
+}
+
+// Tryb serwerów blokad (--servers=S w mpi.c): procesy 0..S-1 nie kradną, tylko przydzielają zasoby. Serwer
+// house % S jest właścicielem domu house, a serwer house % min(S, P) - paserów f z f % min(S, P) równym
+// jego numerowi (o pasera złodziej prosi serwer wyznaczony przez dom, który właśnie okrada). Wejście
+// kosztuje REQ + GRANT + REL do jednego serwera niezależnie od N, zamiast rozgłoszeń do wszystkich.
+// Serwer najpierw odbiera wszystko, co przyszło w cyklu, a dopiero potem przydziela wolne zasoby
+// (wg timestampu, potem rangi) i wysyła przydziały jednym lock_flush.
+typedef struct {
+    int shard, num_servers, num_fence_servers; // shard = numer serwera (= ranga)
+    int num_houses, num_fences;
+    RequestQueue* house_queues; // Czekający na dom (używane tylko domy tego serwera)
+    int* house_holder;          // Kto kradnie w domu (-1 = nikt)
+    int* house_readers;         // Ilu oglądających jest w domu
+    RequestQueue fence_queue;   // Czekający na pasera tego serwera
+    int* fence_holder;          // Kto korzysta z pasera f (-1 = wolny)
+    int* fence_uses;            // Ile razy skorzystano z pasera f (wolny z najmniejszą liczbą idzie pierwszy)
+    int* fence_of_rank;         // Paser, z którego korzysta proces i (-1 = żaden)
+} LockServer;
+
+static inline void lock_server_init(LockServer* server, int my_rank, int num_procs, int num_servers, int num_houses,
+                                    int num_fences) {
+    server->shard = my_rank;
+    server->num_servers = num_servers;
+    server->num_fence_servers = num_servers < num_fences ? num_servers : num_fences;
+    server->num_houses = num_houses;
+    server->num_fences = num_fences;
+    server->house_queues = malloc(num_houses * sizeof(RequestQueue));
+    server->house_holder = malloc(num_houses * sizeof(int));
+    server->house_readers = calloc(num_houses, sizeof(int));
+    for (int h = 0; h < num_houses; h++) {
+        init_queue(&server->house_queues[h], num_procs, my_rank);
+        server->house_holder[h] = -1;
+    }
+    init_queue(&server->fence_queue, num_procs, my_rank);
+    server->fence_holder = malloc(num_fences * sizeof(int));
+    server->fence_uses = calloc(num_fences, sizeof(int));
+    for (int f = 0; f < num_fences; f++) {
+        server->fence_holder[f] = -1;
+    }
+    server->fence_of_rank = malloc(num_procs * sizeof(int));
+    for (int i = 0; i < num_procs; i++) {
+        server->fence_of_rank[i] = -1;
+    }
+}
+
+static inline void lock_server_free(LockServer* server) {
+    for (int h = 0; h < server->num_houses; h++) {
+        free_queue(&server->house_queues[h]);
+    }
+    free(server->house_queues);
+    free(server->house_holder);
+    free(server->house_readers);
+    free_queue(&server->fence_queue);
+    free(server->fence_holder);
+    free(server->fence_uses);
+    free(server->fence_of_rank);
+}
+
+// Wolny paser tego serwera z najmniejszą liczbą użyć albo -1.
+static int lock_server_idle_fence(LockServer* server) {
+    int best = -1;
+    if (server->shard >= server->num_fence_servers) return -1; // Serwer bez paserów
+    for (int f = server->shard; f < server->num_fences; f += server->num_fence_servers) {
+        if (server->fence_holder[f] == -1 && (best == -1 || server->fence_uses[f] < server->fence_uses[best])) {
+            best = f;
+        }
+    }
+    return best;
+}
+
+// Tryb adaptacyjny (lock_set_adapt; --adaptive=1 w mpi.c): każdy dom działa w jednym z dwóch protokołów,
+// zmienianym w biegu.
+//   HOUSE_LAMPORT - kolejka Lamporta: REQ i REL do wszystkich, wejście po późniejszej wiadomości
+//                   od każdego aktywnego procesu; oglądający wchodzą razem.
+//   HOUSE_TOKEN   - token domu na tej samej kolejce żądań (jak Suzuki-Kasami): REQ do wszystkich,
+//                   wchodzi posiadacz tokenu, a przy wyjściu oddaje go najwcześniejszemu żądaniu z kolejki
+//                   albo zatrzymuje - jego następne wejście nie kosztuje wtedy żadnej wiadomości.
+//                   Bez REL i bez czekania na wszystkich, ale oglądanie jest wyłączne.
+// Każdy proces obserwuje dom w oknie adapt_window wyjść z niego: głębokość kolejki przy wyjściu i liczbę
+// nowych żądań (w trybie Lamporta widać wyjścia wszystkich, w trybie tokenu - tylko własne, ale wtedy
+// kolejka posiadacza jest dokładna). Decyduje ten, kto ma dom na wyłączność (kradnący w sekcji Lamporta
+// albo posiadacz tokenu), przy wyjściu z pełnym oknem: gdy czekało średnio mniej niż jeden proces, a żądań
+// przybyło nie więcej niż wyjść - token; gdy czekało średnio co najmniej adapt_high procesów - Lamport.
+// Zmiana zaczyna nową epokę domu:
+//   SWITCH_TOKEN   - zastępuje STEAL_REL decydującego, który od teraz ma token. Kto jeszcze go nie odebrał,
+//                    ma w kolejce jego żądanie przed swoim, więc po staremu nie wejdzie.
+//   SWITCH_LAMPORT - rozsyła posiadacz tokenu poza sekcją; token znika, czekający liczą warunek 2 od nowa.
+// served[i] to zegar ostatniego wyjścia procesu i z domu. Token i SWITCH_LAMPORT niosą tę tablicę, więc
+// żądania obsłużone w trybie tokenu (bez REL) znikają z kolejek przed powrotem do Lamporta, a ich spóźnione
+// REQ są pomijane. Wiadomości różnych nadawców mogą się wyprzedzać: obowiązuje najwyższa znana epoka,
+// a starsza zmiana tylko usuwa żądanie nadawcy i uzupełnia served.
+typedef enum {
+    HOUSE_LAMPORT,
+    HOUSE_TOKEN
+} HouseProtocol;
+
+typedef struct {
+    HouseProtocol protocol;
+    int epoch;
+    bool token;          // Mam token domu (HOUSE_TOKEN)
+    int* served;         // served[i]: zegar ostatniego znanego wyjścia procesu i z domu
+    int window_releases; // Wyjścia z domu zaobserwowane w bieżącym oknie decyzji
+    int window_waiters;  // Suma czekających przy tych wyjściach
+    int window_requests; // Nowe żądania innych w oknie
+} HouseState;
+
+// Wszystkie zasoby procesu za jednym nieblokującym interfejsem: domy 0..houses-1 (kolejki Lamporta)
+// i paser (RESOURCE_FENCE, pula tokenów).
+//   lock_request     - zgłasza żądanie (bez czekania),
+//   lock_try_acquire - zgłasza żądanie, jeśli jeszcze go nie ma, i sprawdza, czy można wejść,
+//   lock_poll        - obsługuje wiadomości, które już przyszły (bez czekania),
+//   lock_wait        - czeka na jedną wiadomość i ją obsługuje,
+//   lock_release     - wyjście z sekcji,
+//   lock_flush       - wysyła wiadomości zebrane w skrzynce nadawczej.
+// Można więc ubiegać się o kilka zasobów naraz i między sprawdzeniami robić coś innego.
+// Każda odebrana wiadomość przechodzi przez lock_dispatch: zegar, liczniki i ślad raz na wiadomość, potem
+// tablica obsługi (handlers[typ]) dla każdego niesionego zdarzenia. Obsługa tylko dokłada odpowiedzi do
+// skrzynki nadawczej - wysyła je lock_poll / lock_wait po obsłużeniu wiadomości.
+#define RESOURCE_FENCE -1
+
+typedef struct LockSet LockSet;
+typedef void (*MessageHandler)(LockSet* locks, const Message* msg);
+
+struct LockSet {
+    int my_rank, num_procs, num_houses;
+    int clock;
+    RequestQueue* house_queues; // Osobna kolejka Lamporta dla każdego domu
+    HouseState* houses;         // Protokół i epoka każdego domu
+    int adapt_window;           // Tryb adaptacyjny: wyjścia na jedną decyzję (0 = wyłączony, zawsze Lamport)
+    int adapt_high;
+    int* highest_ts_received;
+    bool* participant;          // Uczestnicy protokołu - do nich idą rozgłoszenia (domyślnie wszyscy)
+    bool* is_active;            // Kto jeszcze będzie kradł (do warunku 2 Lamporta)
+    bool* pending;              // Od kogo czekam jeszcze na późniejszą wiadomość (warunek 2 Lamporta)
+    int pending_count;
+    Request my_request;
+    int requested_house;        // Dom, o który się ubiegam albo w którym jestem (-1 = żaden)
+    bool house_held;
+    bool fence_requested;       // Żądanie pasera zgłoszone (token w drodze albo już w ręku)
+    bool fence_entered;         // Jestem w sekcji pasera (token mógł przyjść wcześniej)
+    int num_servers;            // Tryb serwerów: liczba serwerów blokad (0 = algorytm rozproszony)
+    int num_fence_servers;
+    int fence_server;           // Serwer, u którego proszę o pasera (wg ostatnio okradanego domu)
+    bool house_granted;         // Serwer przydzielił mi dom
+    LockServer* server;         // Stan serwera (tylko na procesach-serwerach)
+    int lease_ops;              // Dzierżawa: najwięcej operacji pod jednym żądaniem (1 = bez dzierżawy)
+    double lease_s;             //   i najdłuższy jej czas w sekundach
+    int lease_house;            // Dom, którego sekcję trzymam poza operacją (-1 = żaden)
+    int lease_used;             // Operacje wykonane pod bieżącym żądaniem
+    double lease_start;         // Chwila wejścia z bieżącym żądaniem (bench_now)
+    bool* ra_permission;        // Ricart-Agrawala: [dom * num_procs + j] - mam zgodę j (NULL = kolejki Lamporta)
+    int* ra_missing;            //   ilu zgód brakuje na dom
+    int* deferred;              //   komu odkładam zgodę do wyjścia z sekcji
+    int deferred_count;
+    bool external_progress;     // Wiadomości obsługuje inny wątek (lock_poll nic nie robi)
+    MessageHandler handlers[MSG_TERMINATE + 1];
+    FencePool* fences;          // NULL = bez paserów
+    OutBox* outbox;
+    LockTransport transport;
+    BenchStats* stats;          // NULL = wiadomości nie są liczone (po zakończeniu własnych operacji)
+    struct Metrics* metrics;    // Głębokości kolejek (NULL = bez rejestru)
+    Trace* trace;
+};
+
+static void lock_send(LockSet* locks, const Message* msg, int target) {
+    outbox_add(locks->outbox, msg, target, &locks->transport, locks->stats, locks->trace);
+}
+
+// Do wszystkich pozostałych uczestników.
+static void lock_send_all(LockSet* locks, const Message* msg) {
+    for (int j = 0; j < locks->num_procs; j++) {
+        if (j != locks->my_rank && locks->participant[j]) lock_send(locks, msg, j);
+    }
+}
+
+// Wysyła wiadomości zebrane w skrzynce nadawczej (zwolnienia czekają tam na doklejenie kolejnego żądania).
+static void lock_flush(LockSet* locks) {
+    outbox_flush(locks->outbox, &locks->transport, locks->stats, locks->trace);
+}
+
+// Głębokości kolejek do rejestru metryk: żądania domów (suma po domach) i czekający na pasera
+// (u serwera jego kolejka, w algorytmie rozproszonym - znane mi nieobsłużone żądania), a w trybie
+// Ricarta-Agrawali - odłożone zgody.
+static void lock_note_depths(LockSet* locks) {
+#ifndef LOCKSET_NO_MPI
+    if (!locks->metrics) return;
+    if (locks->ra_permission) {
+        metrics_depth(locks->metrics, METRIC_DEFERRED, locks->deferred_count);
+        return;
+    }
+    RequestQueue* queues = locks->server ? locks->server->house_queues : locks->house_queues;
+    long houses = 0;
+    for (int h = 0; h < locks->num_houses; h++) {
+        // W trybie tokenu dokładną kolejkę ma tylko posiadacz (u innych zostają obsłużone żądania)
+        if (!locks->server && locks->houses[h].protocol == HOUSE_TOKEN && !locks->houses[h].token) continue;
+        houses += queues[h].size;
+    }
+    long fences = 0;
+    if (locks->server) {
+        fences = locks->server->fence_queue.size;
+    } else if (locks->fences) {
+        for (int i = 0; i < locks->num_procs; i++) {
+            if (locks->fences->request_numbers[i] > locks->fences->served[i]) fences++;
+        }
+    }
+    metrics_depth(locks->metrics, METRIC_STEAL_QUEUE, houses);
+    metrics_depth(locks->metrics, METRIC_FENCE_QUEUE, fences);
+#else
+    (void)locks;
+#endif
+}
+
+static void fence_send_token(LockSet* locks, int f, int target) {
+    FencePool* pool = locks->fences;
+    pool->served[target] = pool->request_numbers[target];
+    pool->held[f] = false;
+
+    locks->clock++;
+    Message msg = {.type = MSG_FENCE_TOKEN, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1};
+    lock_send(locks, &msg, target);
+    int payload[2 + pool->num_procs];
+    payload[0] = f;
+    payload[1] = pool->uses[f];
+    memcpy(&payload[2], pool->served, pool->num_procs * sizeof(int));
+    locks->transport.send_payload(locks->transport.ctx, payload, 2 + pool->num_procs, target, FENCE_TOKEN_TAG);
+}
+
+// Żądanie pasera: wolny token na miejscu (bez wiadomości) albo FENCE_REQ do wszystkich (w skrzynce nadawczej).
+static void fence_request(LockSet* locks) {
+    FencePool* pool = locks->fences;
+    int f = fence_take_idle(pool);
+    if (f != -1) {
+        pool->in_use = f;
+        return;
+    }
+    pool->request_numbers[pool->my_rank]++;
+    pool->waiting = true;
+    Message msg = {.type = MSG_FENCE_REQ, .timestamp = locks->clock, .sender_rank = pool->my_rank, .house_id = -1,
+                   .request_number = pool->request_numbers[pool->my_rank]};
+    lock_send_all(locks, &msg);
+}
+
+// Oddaje wolne tokeny czekającym procesom.
+static void fence_pass_idle(LockSet* locks) {
+    int f;
+    int target;
+    while ((target = fence_next_waiting(locks->fences)) != -1 && (f = fence_take_idle(locks->fences)) != -1) {
+        fence_send_token(locks, f, target);
+    }
+}
+
+// Obsługa FENCE_REQ i FENCE_TOKEN (w każdej pętli odbioru) - wolne tokeny od razu idą dalej.
+static void lock_on_fence(LockSet* locks, const Message* msg) {
+    FencePool* pool = locks->fences;
+    if (msg->type == MSG_FENCE_REQ) {
+        pool->request_numbers[msg->sender_rank] = max(pool->request_numbers[msg->sender_rank], msg->request_number);
+    } else if (msg->type == MSG_FENCE_TOKEN) {
+        int payload[2 + pool->num_procs];
+        locks->transport.recv_payload(locks->transport.ctx, payload, 2 + pool->num_procs, msg->sender_rank,
+                                      FENCE_TOKEN_TAG);
+        int f = payload[0];
+        pool->held[f] = true;
+        pool->uses[f] = payload[1];
+        for (int i = 0; i < pool->num_procs; i++) {
+            pool->served[i] = max(pool->served[i], payload[2 + i]);
+        }
+        if (pool->waiting) {
+            pool->waiting = false;
+            pool->in_use = f;
+            pool->served[pool->my_rank] = pool->request_numbers[pool->my_rank];
+        }
+    }
+    fence_pass_idle(locks);
+}
+
+// Wystarczy dowolna późniejsza wiadomość (o dowolnym domu) - kanały są FIFO, więc
+// wcześniejsze żądanie tego procesu o mój dom na pewno już dotarło.
+static void lock_note_steal_message(LockSet* locks, const Message* msg) {
+    locks->highest_ts_received[msg->sender_rank] = max(locks->highest_ts_received[msg->sender_rank], msg->timestamp);
+    if (locks->pending[msg->sender_rank] && is_later_message(msg->timestamp, msg->sender_rank, locks->my_request)) {
+        locks->pending[msg->sender_rank] = false;
+        locks->pending_count--;
+    }
+}
+
+// Warunek 2 Lamporta dla mojego żądania: od kogo czekam jeszcze na późniejszą wiadomość.
+// Liczone raz na wejście (i po powrocie domu do Lamporta), potem tylko zmniejszane przy odbiorze wiadomości.
+static void lock_count_pending(LockSet* locks) {
+    locks->pending_count = 0;
+    for (int i = 0; i < locks->num_procs; i++) {
+        locks->pending[i] = (i != locks->my_rank && locks->is_active[i] &&
+                             !is_later_message(locks->highest_ts_received[i], i, locks->my_request));
+        if (locks->pending[i]) locks->pending_count++;
+    }
+}
+
+// Usuwa z kolejki domu żądania już obsłużone (wg served).
+static void house_prune(LockSet* locks, int h) {
+    RequestQueue* queue = &locks->house_queues[h];
+    int* served = locks->houses[h].served;
+    for (int i = 0; i < locks->num_procs; i++) {
+        int slot = queue->slot_of_rank[i];
+        if (slot != -1 && queue->heap[slot].timestamp <= served[i]) remove_from_queue_by_rank(queue, i);
+    }
+}
+
+// Ładunek HOUSE_TOKEN i SWITCH_LAMPORT: tablica served (osobnym tagiem, jak ładunek tokenu pasera).
+static void house_send_served(LockSet* locks, int h, int target) {
+    locks->transport.send_payload(locks->transport.ctx, locks->houses[h].served, locks->num_procs, target,
+                                  HOUSE_TOKEN_TAG);
+}
+
+static void house_recv_served(LockSet* locks, const Message* msg) {
+    int served[locks->num_procs];
+    locks->transport.recv_payload(locks->transport.ctx, served, locks->num_procs, msg->sender_rank, HOUSE_TOKEN_TAG);
+    HouseState* house = &locks->houses[msg->house_id];
+    for (int i = 0; i < locks->num_procs; i++) {
+        house->served[i] = max(house->served[i], served[i]);
+    }
+    house_prune(locks, msg->house_id);
+}
+
+// Przejście domu do epoki epoch (starsze i bieżąca są ignorowane); true = przyjęte.
+static bool house_enter_epoch(LockSet* locks, int h, int epoch, HouseProtocol protocol) {
+    HouseState* house = &locks->houses[h];
+    if (epoch <= house->epoch) return false;
+    house->epoch = epoch;
+    house->protocol = protocol;
+    house->token = false;
+    house->window_releases = house->window_waiters = house->window_requests = 0;
+    if (protocol == HOUSE_LAMPORT && locks->requested_house == h && !locks->house_held) {
+        lock_count_pending(locks); // Czekałem na token - teraz warunki Lamporta
+    }
+    LOG(1, "--- Proces %d --- [Zegar: %d] Dom %d: epoka %d, protokół %s.\n", locks->my_rank, locks->clock, h, epoch,
+        protocol == HOUSE_TOKEN ? "token" : "Lamport");
+    return true;
+}
+
+// Wyjście z domu (moje albo cudze) do okna decyzji: ilu czekało.
+static void house_observe_release(LockSet* locks, int h) {
+    HouseState* house = &locks->houses[h];
+    if (locks->adapt_window <= 0 || house->window_releases >= locks->adapt_window) return;
+    house->window_releases++;
+    house->window_waiters += locks->house_queues[h].size;
+}
+
+// Posiadacz tokenu poza domem oddaje go najwcześniejszemu czekającemu; true = oddał (do wysłania w skrzynce).
+static bool house_pass_token(LockSet* locks, int h) {
+    HouseState* house = &locks->houses[h];
+    RequestQueue* queue = &locks->house_queues[h];
+    if (!house->token || locks->requested_house == h || queue->size == 0) return false;
+    int target = queue->heap[0].rank;
+    remove_from_queue_by_rank(queue, target);
+    house->token = false;
+    locks->clock++;
+    Message msg = {.type = MSG_HOUSE_TOKEN, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = h,
+                   .epoch = house->epoch};
+    lock_send(locks, &msg, target);
+    house_send_served(locks, h, target); // Ładunek może wyprzedzić nagłówek - odbiorca czeka na niego tagiem
+    return true;
+}
+
+// Dzierżawa (lease_ops > 1, dom w trybie Lamporta): kradnący zostawia przy wyjściu żądanie na czele kolejki
+// domu zamiast rozsyłać STEAL_REL, a następną kradzież w tym domu zaczyna bez żadnej wiadomości - dopóki
+// nie wyczerpie lease_ops operacji ani lease_s sekund i nikt inny o dom nie prosi. Cudze STEAL_REQ o ten
+// dom od razu odbiera dzierżawę, więc czekający czeka najwyżej na obsłużenie wiadomości przez dzierżawcę.
+// Oddaje sekcję trzymaną w ramach dzierżawy (wyjście z ostatniej operacji jest już zapisane).
+static void lock_lease_revoke(LockSet* locks) {
+    int h = locks->lease_house;
+    if (h == -1) return;
+    locks->lease_house = -1;
+    locks->clock++; // Zdarzenie lokalne: wysłanie zwolnienia
+    remove_from_queue_by_rank(&locks->house_queues[h], locks->my_rank);
+    locks->houses[h].served[locks->my_rank] = locks->clock;
+    Message msg_steal_rel = {.type = MSG_STEAL_REL, .timestamp = locks->clock, .sender_rank = locks->my_rank,
+                             .house_id = h, .mode = ACCESS_EXCLUSIVE};
+    lock_send_all(locks, &msg_steal_rel);
+    lock_note_depths(locks);
+}
+
+static void lock_on_steal_req(LockSet* locks, const Message* msg) {
+    lock_note_steal_message(locks, msg);
+    if (locks->lease_house == msg->house_id) lock_lease_revoke(locks); // Ktoś czeka - dzierżawa wraca
+    HouseState* house = &locks->houses[msg->house_id];
+    if (msg->timestamp <= house->served[msg->sender_rank]) return; // Spóźnione żądanie, już obsłużone
+    Request new_req = {msg->timestamp, msg->sender_rank, msg->mode};
+    add_to_queue(&locks->house_queues[msg->house_id], new_req);
+    if (house->window_releases < locks->adapt_window) house->window_requests++;
+    if (house->protocol == HOUSE_TOKEN) { // Wolny token od razu do czekającego
+        house_pass_token(locks, msg->house_id);
+        return;
+    }
+    // Oglądający czeka na późniejszą wiadomość także ode mnie - gdy sam oglądam ten dom (albo czekam na to
+    // z wcześniejszym żądaniem), potwierdzam od razu, zamiast kazać mu czekać na moje zwolnienie.
+    if (new_req.mode == ACCESS_SHARED && locks->my_request.mode == ACCESS_SHARED &&
+        locks->requested_house == msg->house_id && request_before(locks->my_request, new_req)) {
+        Message ack = {.type = MSG_STEAL_ACK, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1};
+        lock_send(locks, &ack, msg->sender_rank);
+    }
+}
+
+static void lock_on_steal_rel(LockSet* locks, const Message* msg) {
+    lock_note_steal_message(locks, msg);
+    remove_from_queue_by_rank(&locks->house_queues[msg->house_id], msg->sender_rank);
+    HouseState* house = &locks->houses[msg->house_id];
+    house->served[msg->sender_rank] = max(house->served[msg->sender_rank], msg->timestamp);
+    house_observe_release(locks, msg->house_id);
+}
+
+static void lock_on_house_token(LockSet* locks, const Message* msg) {
+    lock_note_steal_message(locks, msg);
+    house_recv_served(locks, msg);
+    house_enter_epoch(locks, msg->house_id, msg->epoch, HOUSE_TOKEN); // Token wyprzedził SWITCH_TOKEN
+    locks->houses[msg->house_id].token = true;
+    house_pass_token(locks, msg->house_id); // Już nie czekam na ten dom - token idzie dalej
+}
+
+static void lock_on_switch_token(LockSet* locks, const Message* msg) {
+    lock_on_steal_rel(locks, msg); // Nadawca wyszedł z domu i zatrzymał token
+    house_enter_epoch(locks, msg->house_id, msg->epoch, HOUSE_TOKEN);
+}
+
+static void lock_on_switch_lamport(LockSet* locks, const Message* msg) {
+    lock_note_steal_message(locks, msg);
+    house_recv_served(locks, msg);
+    house_enter_epoch(locks, msg->house_id, msg->epoch, HOUSE_LAMPORT);
+}
+
+static void lock_on_terminate(LockSet* locks, const Message* msg) { // Ostatnie zwolnienie nadawcy
+    locks->is_active[msg->sender_rank] = false;
+    if (locks->pending[msg->sender_rank]) {
+        locks->pending[msg->sender_rank] = false;
+        locks->pending_count--;
+    }
+}
+
+static void lock_on_grant(LockSet* locks, const Message* msg) { // Tryb serwerów: dom albo paser jest mój
+    if (msg->house_id != -1) {
+        locks->house_granted = true;
+    } else {
+        locks->fences->in_use = msg->request_number;
+    }
+}
+
+// Obsługa po stronie serwera: żądania i zwolnienia tylko zmieniają stan, przydziela lock_server_grant.
+static void server_on_steal_req(LockSet* locks, const Message* msg) {
+    Request new_req = {msg->timestamp, msg->sender_rank, msg->mode};
+    add_to_queue(&locks->server->house_queues[msg->house_id], new_req);
+}
+
+static void server_on_steal_rel(LockSet* locks, const Message* msg) {
+    if (msg->mode == ACCESS_SHARED) {
+        locks->server->house_readers[msg->house_id]--;
+    } else {
+        locks->server->house_holder[msg->house_id] = -1;
+    }
+}
+
+static void server_on_fence_req(LockSet* locks, const Message* msg) {
+    Request new_req = {msg->timestamp, msg->sender_rank, ACCESS_EXCLUSIVE};
+    add_to_queue(&locks->server->fence_queue, new_req);
+}
+
+static void server_on_fence_rel(LockSet* locks, const Message* msg) {
+    LockServer* server = locks->server;
+    int f = server->fence_of_rank[msg->sender_rank];
+    server->fence_holder[f] = -1;
+    server->fence_uses[f]++;
+    server->fence_of_rank[msg->sender_rank] = -1;
+}
+
+// Ricart-Agrawala z optymalizacją Roucairola-Carvalho (lock_set_use_ra): zgoda (ACK) od procesu j pozostaje
+// ważna, dopóki nie oddam jej j w odpowiedzi na jego REQ. REQ wysyłam więc tylko do procesów, którym oddałem
+// zgodę - powtórne wejście bez rywalizacji nie kosztuje żadnej wiadomości. Dla każdej pary procesów zgodę
+// ma dokładnie jeden z nich (albo jest w drodze); na początku ma ją proces o niższej randze.
+// Odpowiedź odkładam, gdy jestem w sekcji (mogłem do niej wejść bez pytania nadawcy, więc jego żądanie może
+// mieć nawet niższy timestamp) albo gdy sam ubiegam się o ten dom z wcześniejszym żądaniem.
+static void ra_on_steal_req(LockSet* locks, const Message* msg) {
+    int h = msg->house_id;
+    Request req = {msg->timestamp, msg->sender_rank, msg->mode};
+    if (locks->requested_house == h && (locks->house_held || request_before(locks->my_request, req))) {
+        locks->deferred[locks->deferred_count++] = msg->sender_rank;
+        return;
+    }
+    bool* permission = &locks->ra_permission[h * locks->num_procs];
+    bool had_permission = permission[msg->sender_rank];
+    if (had_permission) { // Oddaję swoją zgodę nadawcy
+        permission[msg->sender_rank] = false;
+        locks->ra_missing[h]++;
+    }
+    locks->clock++; // Zdarzenie lokalne: wysłanie ACK
+    Message ack = {.type = MSG_STEAL_ACK, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = h};
+    lock_send(locks, &ack, msg->sender_rank);
+    // Jeśli sam się ubiegam, a nadawca nie dostał mojego REQ (miałem jego zgodę), muszę teraz o nią poprosić
+    // (REQ doklejone do ACK - jedna wiadomość)
+    if (locks->requested_house == h && had_permission) {
+        Message request = {.type = MSG_STEAL_REQ, .timestamp = locks->my_request.timestamp,
+                           .sender_rank = locks->my_rank, .house_id = h, .mode = locks->my_request.mode};
+        lock_send(locks, &request, msg->sender_rank);
+    }
+}
+
+static void ra_on_steal_ack(LockSet* locks, const Message* msg) {
+    bool* permission = &locks->ra_permission[msg->house_id * locks->num_procs];
+    if (!permission[msg->sender_rank]) { // Zgoda wraca do mnie
+        permission[msg->sender_rank] = true;
+        locks->ra_missing[msg->house_id]--;
+    }
+}
+
+// fences == NULL: bez paserów. Zbiór pamięta wskaźniki do skrzynki i paserów - nie mogą się przenieść.
+static void lock_set_init(LockSet* locks, int my_rank, int num_procs, int num_houses, FencePool* fences, OutBox* outbox,
+                          LockTransport transport, BenchStats* stats, Trace* trace) {
+    locks->my_rank = my_rank;
+    locks->num_procs = num_procs;
+    locks->num_houses = num_houses;
+    locks->clock = 0;
+    locks->house_queues = malloc(num_houses * sizeof(RequestQueue));
+    locks->houses = malloc(num_houses * sizeof(HouseState));
+    for (int h = 0; h < num_houses; h++) {
+        init_queue(&locks->house_queues[h], num_procs, my_rank);
+        locks->houses[h] = (HouseState){HOUSE_LAMPORT, 0, false, calloc(num_procs, sizeof(int)), 0, 0, 0};
+    }
+    locks->adapt_window = 0;
+    locks->adapt_high = 0;
+    locks->highest_ts_received = calloc(num_procs, sizeof(int));
+    locks->participant = malloc(num_procs * sizeof(bool));
+    locks->is_active = malloc(num_procs * sizeof(bool));
+    locks->pending = calloc(num_procs, sizeof(bool));
+    for (int i = 0; i < num_procs; i++) {
+        locks->participant[i] = true;
+        locks->is_active[i] = true; // Na początku wszystkie procesy są aktywne
+    }
+    locks->pending_count = 0;
+    locks->my_request = (Request){-1, my_rank, ACCESS_EXCLUSIVE};
+    locks->requested_house = -1;
+    locks->house_held = false;
+    locks->fence_requested = false;
+    locks->fence_entered = false;
+    locks->handlers[MSG_STEAL_REQ] = lock_on_steal_req;
+    locks->handlers[MSG_STEAL_REL] = lock_on_steal_rel;
+    locks->handlers[MSG_STEAL_ACK] = lock_note_steal_message;
+    locks->handlers[MSG_FENCE_REQ] = lock_on_fence;
+    locks->handlers[MSG_FENCE_TOKEN] = lock_on_fence;
+    locks->handlers[MSG_GRANT] = lock_on_grant;
+    locks->handlers[MSG_FENCE_REL] = server_on_fence_rel; // Przychodzi tylko do serwera
+    locks->handlers[MSG_HOUSE_TOKEN] = lock_on_house_token;
+    locks->handlers[MSG_SWITCH_TOKEN] = lock_on_switch_token;
+    locks->handlers[MSG_SWITCH_LAMPORT] = lock_on_switch_lamport;
+    locks->handlers[MSG_TERMINATE] = lock_on_terminate;
+    locks->num_servers = 0;
+    locks->num_fence_servers = 0;
+    locks->fence_server = -1;
+    locks->house_granted = false;
+    locks->server = NULL;
+    locks->lease_ops = 1;
+    locks->lease_s = 0.0;
+    locks->lease_house = -1;
+    locks->lease_used = 0;
+    locks->lease_start = 0.0;
+    locks->ra_permission = NULL;
+    locks->ra_missing = NULL;
+    locks->deferred = NULL;
+    locks->deferred_count = 0;
+    locks->external_progress = false;
+    locks->fences = fences;
+    locks->outbox = outbox;
+    locks->transport = transport;
+    locks->stats = stats;
+    locks->metrics = stats ? stats->metrics : NULL;
+    locks->trace = trace;
+}
+
+static void lock_set_free(LockSet* locks) {
+    for (int h = 0; h < locks->num_houses; h++) {
+        free_queue(&locks->house_queues[h]);
+        free(locks->houses[h].served);
+    }
+    free(locks->house_queues);
+    free(locks->houses);
+    free(locks->highest_ts_received);
+    free(locks->participant);
+    free(locks->is_active);
+    free(locks->pending);
+    free(locks->ra_permission);
+    free(locks->ra_missing);
+    free(locks->deferred);
+}
+
+// Uczestnicy protokołu (np. tylko liderzy węzłów w na3.c --lock=hier): rozgłoszenia idą tylko do nich
+// i tylko na nich czeka warunek 2 Lamporta. Pozostali nie wysyłają ani nie dostają wiadomości zbioru.
+static inline void lock_set_participants(LockSet* locks, const bool* participant) {
+    for (int i = 0; i < locks->num_procs; i++) {
+        locks->participant[i] = participant[i];
+        locks->is_active[i] = participant[i];
+    }
+}
+
+// Przełącza zbiór na tryb serwerów. server != NULL: ten proces jest serwerem - inna tablica obsługi.
+static inline void lock_set_use_servers(LockSet* locks, int num_servers, int num_fences, LockServer* server) {
+    locks->num_servers = num_servers;
+    locks->num_fence_servers = num_servers < num_fences ? num_servers : num_fences;
+    locks->server = server;
+    if (server) {
+        locks->handlers[MSG_STEAL_REQ] = server_on_steal_req;
+        locks->handlers[MSG_STEAL_REL] = server_on_steal_rel;
+        locks->handlers[MSG_FENCE_REQ] = server_on_fence_req;
+    }
+}
+
+// Przełącza domy na Ricarta-Agrawalę (zgody zamiast kolejek; bez STEAL_REL i bez TERMINATE).
+static inline void lock_set_use_ra(LockSet* locks) {
+    int n = locks->num_procs;
+    locks->ra_permission = malloc(locks->num_houses * n * sizeof(bool));
+    locks->ra_missing = calloc(locks->num_houses, sizeof(int));
+    locks->deferred = malloc(n * sizeof(int));
+    for (int h = 0; h < locks->num_houses; h++) {
+        for (int i = 0; i < n; i++) {
+            // Z każdej pary zgodę ma na start niższa ranga
+            bool has = (i == locks->my_rank || locks->my_rank < i);
+            locks->ra_permission[h * n + i] = has;
+            if (!has) locks->ra_missing[h]++;
+        }
+    }
+    locks->handlers[MSG_STEAL_REQ] = ra_on_steal_req;
+    locks->handlers[MSG_STEAL_ACK] = ra_on_steal_ack;
+}
+
+// Aktualizacja zegara, liczniki i ślad odebranej wiadomości, potem obsługa każdego niesionego zdarzenia:
+// najpierw type, potem doklejone (rosnąco wg typu) - każde jako osobna wiadomość z tym samym timestampem.
+static void lock_dispatch(LockSet* locks, const Message* msg) {
+    locks->clock = max(locks->clock, msg->timestamp) + 1;
+    bench_message_received(locks->stats, msg->type, msg->piggyback);
+    trace_event(locks->trace, TRACE_RECV, locks->clock, msg->sender_rank, msg->type, msg->house_id);
+    LOG(2, "--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d z timestampem (ts=%d). Aktualizuję zegar.\n", locks->my_rank, locks->clock, get_message_type_name(msg->type), msg->sender_rank, msg->timestamp);
+    Message event = *msg;
+    event.piggyback = 0;
+    locks->handlers[msg->type](locks, &event);
+    for (int t = 0; msg->piggyback >> t; t++) {
+        if (msg->piggyback & (1 << t)) {
+            event.type = t;
+            locks->handlers[t](locks, &event);
+        }
+    }
+    lock_note_depths(locks);
+}
+
+// Obsługuje wszystkie wiadomości, które już przyszły, i wysyła odpowiedzi; zwraca liczbę wiadomości.
+// Z external_progress wiadomości obsługuje inny wątek - tu nic się nie dzieje.
+static int lock_poll(LockSet* locks) {
+    if (locks->external_progress) return 0;
+    int handled = 0;
+    Message msg;
+    while (locks->transport.try_recv(locks->transport.ctx, &msg)) {
+        lock_dispatch(locks, &msg);
+        handled++;
+    }
+    if (handled > 0) lock_flush(locks);
+    return handled;
+}
+
+// Czeka na jedną wiadomość (w MPI: krótkie aktywne oczekiwanie, potem blokowanie), obsługuje ją
+// i wysyła odpowiedzi.
+static void lock_wait(LockSet* locks) {
+    Message msg;
+    locks->transport.recv(locks->transport.ctx, &msg);
+    lock_dispatch(locks, &msg);
+    lock_flush(locks);
+}
+
+static void lock_request_house(LockSet* locks, int house, AccessMode mode) {
+    if (locks->ra_permission && !locks->external_progress) {
+        // Ricart-Agrawala: najpierw obsługuję żądania, które przyszły, gdy byłem zajęty (zegar je uwzględni,
+        // a procesy, które czekają dłużej, dostaną moją zgodę zamiast kolejnego pominięcia). ACK z tego
+        // kroku pójdą razem z moim REQ - oddając zgodę procesowi, i tak muszę go o nią poprosić.
+        Message msg;
+        while (locks->transport.try_recv(locks->transport.ctx, &msg)) {
+            lock_dispatch(locks, &msg);
+        }
+    }
+    locks->clock++;
+    locks->my_request = (Request){locks->clock, locks->my_rank, mode};
+    locks->requested_house = house;
+    bench_request(locks->stats, house, mode == ACCESS_SHARED);
+    trace_event(locks->trace, TRACE_CS_REQUEST, locks->clock, -1, -1, house);
+    Message msg_out_steal = {.type = MSG_STEAL_REQ, .timestamp = locks->my_request.timestamp,
+                             .sender_rank = locks->my_rank, .house_id = house, .mode = mode};
+    if (locks->num_servers > 0) { // Jedno żądanie do serwera domu zamiast rozgłoszenia
+        locks->fence_server = house % locks->num_fence_servers;
+        lock_send(locks, &msg_out_steal, house % locks->num_servers);
+        return;
+    }
+    if (locks->ra_permission) { // Żądanie tylko do procesów, którym oddałem zgodę
+        bool* permission = &locks->ra_permission[house * locks->num_procs];
+        for (int j = 0; j < locks->num_procs; j++) {
+            if (j != locks->my_rank && locks->participant[j] && !permission[j]) lock_send(locks, &msg_out_steal, j);
+        }
+        return;
+    }
+    add_to_queue(&locks->house_queues[house], locks->my_request);
+    if (locks->houses[house].token) return; // Mam token domu - wchodzę bez żadnej wiadomości
+    lock_count_pending(locks);
+    lock_send_all(locks, &msg_out_steal);
+}
+
+// Zgłasza żądanie zasobu (FENCE_REQ dokleja się do zwolnień czekających w skrzynce nadawczej).
+// mode dotyczy domów; paser jest zawsze wyłączny.
+static void lock_request(LockSet* locks, int resource, AccessMode mode) {
+    if (resource == RESOURCE_FENCE) {
+        locks->clock++;
+        locks->fence_requested = true;
+        trace_event(locks->trace, TRACE_FENCE_REQUEST, locks->clock, -1, -1, -1);
+        if (locks->num_servers > 0) {
+            Message msg = {.type = MSG_FENCE_REQ, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1};
+            lock_send(locks, &msg, locks->fence_server);
+        } else {
+            fence_request(locks);
+        }
+    } else {
+        lock_request_house(locks, resource, mode);
+    }
+    lock_note_depths(locks);
+    lock_flush(locks);
+}
+
+// Czy dzierżawa domu h obejmie kolejną operację: limit operacji i czasu nie jest wyczerpany, a po obsłużeniu
+// tego, co już przyszło, w kolejce jest tylko moje żądanie.
+static bool lock_lease_usable(LockSet* locks, int h) {
+    if (locks->lease_ops <= 1 || locks->num_servers > 0 || locks->ra_permission ||
+        locks->houses[h].protocol != HOUSE_LAMPORT || locks->lease_used >= locks->lease_ops ||
+        bench_now() - locks->lease_start >= locks->lease_s) {
+        return false;
+    }
+    lock_poll(locks);
+    RequestQueue* queue = &locks->house_queues[h];
+    return queue->slot_of_rank[locks->my_rank] != -1 && queue->size == 1;
+}
+
+// Zgłasza żądanie (jeśli jeszcze go nie ma) i sprawdza, czy można wejść; true = jestem w sekcji.
+static bool lock_try_acquire(LockSet* locks, int resource, AccessMode mode) {
+    bool granted;
+    if (resource == RESOURCE_FENCE) {
+        if (!locks->fence_requested) lock_request(locks, resource, ACCESS_EXCLUSIVE);
+        lock_flush(locks);
+        if (locks->fence_entered) return true;
+        granted = locks->fences->in_use != -1;
+        if (granted) {
+            locks->fence_entered = true;
+            locks->clock++;
+            trace_event(locks->trace, TRACE_FENCE_ENTER, locks->clock, -1, -1, locks->fences->in_use);
+        }
+        return granted;
+    }
+    if (locks->lease_house != -1 && locks->requested_house == -1) {
+        if (locks->lease_house == resource && mode == ACCESS_EXCLUSIVE && lock_lease_usable(locks, resource)) {
+            // Pod ważną dzierżawą kradzież wchodzi od razu, bez żadnej wiadomości
+            locks->lease_house = -1;
+            locks->lease_used++;
+            locks->requested_house = resource;
+            locks->house_held = true;
+            locks->clock++;
+            bench_request(locks->stats, resource, false);
+            trace_event(locks->trace, TRACE_CS_REQUEST, locks->clock, -1, -1, resource);
+            bench_enter(locks->stats);
+            trace_event(locks->trace, TRACE_CS_ENTER, locks->clock, -1, -1, resource);
+            return true;
+        }
+        lock_lease_revoke(locks); // Ktoś czeka, dzierżawa wygasła albo chodzi o inny dom - zwykłe żądanie
+    }
+    if (locks->requested_house != resource) lock_request(locks, resource, mode);
+    if (locks->house_held) return true;
+    if (locks->num_servers > 0) {
+        granted = locks->house_granted;
+    } else if (locks->ra_permission) {
+        granted = locks->ra_missing[resource] == 0;
+    } else if (locks->houses[resource].protocol == HOUSE_TOKEN) {
+        granted = locks->houses[resource].token;
+    } else {
+        granted = my_request_may_enter(&locks->house_queues[resource], mode) && locks->pending_count == 0;
+    }
+    if (granted) {
+        locks->house_held = true;
+        locks->clock++;
+        locks->lease_used = 1;
+        locks->lease_start = bench_now();
+        bench_enter(locks->stats);
+        trace_event(locks->trace, mode == ACCESS_SHARED ? TRACE_READ_ENTER : TRACE_CS_ENTER, locks->clock, -1, -1, resource);
+    }
+    return granted;
+}
+
+// Decyzja o protokole domu przy moim wyjściu (tryb adaptacyjny): zwraca protokół na dalej.
+static HouseProtocol house_decide(LockSet* locks, int h, AccessMode mode) {
+    HouseState* house = &locks->houses[h];
+    house_observe_release(locks, h);
+    if (locks->adapt_window <= 0 || house->window_releases < locks->adapt_window) return house->protocol;
+
+    HouseProtocol next = house->protocol;
+    if (house->protocol == HOUSE_LAMPORT) {
+        // Oglądający nie ma domu na wyłączność - przy nim zmiany nie ma (okno czeka na kradnącego)
+        if (mode == ACCESS_SHARED) return house->protocol;
+        if (house->window_waiters < house->window_releases && house->window_requests <= house->window_releases) {
+            next = HOUSE_TOKEN;
+        }
+    } else if (house->window_waiters >= locks->adapt_high * house->window_releases) {
+        next = HOUSE_LAMPORT;
+    }
+    house->window_releases = house->window_waiters = house->window_requests = 0;
+    return next;
+}
+
+// Nowa epoka domu ogłaszana przez tego, kto ma go na wyłączność (przy wyjściu).
+static void house_switch(LockSet* locks, int h, HouseProtocol protocol) {
+    HouseState* house = &locks->houses[h];
+    house->epoch++;
+    house->protocol = protocol;
+    house->token = (protocol == HOUSE_TOKEN);
+    LOG(1, "--- Proces %d --- [Zegar: %d] Dom %d: zmieniam protokół na %s (epoka %d).\n", locks->my_rank, locks->clock, h,
+        protocol == HOUSE_TOKEN ? "token" : "Lamport", house->epoch);
+    Message msg = {.type = protocol == HOUSE_TOKEN ? MSG_SWITCH_TOKEN : MSG_SWITCH_LAMPORT, .timestamp = locks->clock,
+                   .sender_rank = locks->my_rank, .house_id = h, .epoch = house->epoch};
+    lock_send_all(locks, &msg);
+    if (protocol == HOUSE_LAMPORT) {
+        for (int j = 0; j < locks->num_procs; j++) {
+            if (j != locks->my_rank && locks->participant[j]) house_send_served(locks, h, j);
+        }
+    }
+}
+
+// Wyjście z sekcji. Zwolnienie domu czeka w skrzynce nadawczej do najbliższego lock_try_acquire/lock_flush,
+// żeby zgłoszone zaraz po nim żądanie pasera poszło w tej samej wiadomości. last = ostatnia kradzież procesu.
+// Kradzież może zostawić dom u siebie na następną operację (dzierżawa), jeśli nikt inny o niego nie prosi.
+static void lock_release(LockSet* locks, int resource, bool last) {
+    locks->clock++;
+    if (resource == RESOURCE_FENCE) {
+        int fence_id = locks->fences->in_use;
+        trace_event(locks->trace, TRACE_FENCE_EXIT, locks->clock, -1, -1, fence_id);
+        locks->fences->in_use = -1;
+        locks->fence_requested = false;
+        locks->fence_entered = false;
+        if (locks->num_servers > 0) { // Paser wraca do serwera (liczbę użyć prowadzi serwer)
+            Message msg = {.type = MSG_FENCE_REL, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1};
+            lock_send(locks, &msg, locks->fence_server);
+            return;
+        }
+        locks->fences->uses[fence_id]++;
+        fence_pass_idle(locks); // Token do następnego czekającego
+        return;
+    }
+    AccessMode mode = locks->my_request.mode;
+    bench_exit(locks->stats);
+    trace_event(locks->trace, mode == ACCESS_SHARED ? TRACE_READ_EXIT : TRACE_CS_EXIT, locks->clock, -1, -1, resource);
+    if (!last && mode == ACCESS_EXCLUSIVE && lock_lease_usable(locks, resource)) {
+        locks->lease_house = resource; // Żądanie zostaje na czele kolejki - bez STEAL_REL
+        locks->requested_house = -1;
+        locks->house_held = false;
+        return;
+    }
+    remove_from_queue_by_rank(&locks->house_queues[resource], locks->my_rank);
+    lock_note_depths(locks);
+    locks->requested_house = -1;
+    locks->house_held = false;
+
+    if (locks->ra_permission) { // Odłożone zgody z bieżącym zegarem; bez REL i TERMINATE
+        bool* permission = &locks->ra_permission[resource * locks->num_procs];
+        for (int i = 0; i < locks->deferred_count; i++) {
+            int target = locks->deferred[i];
+            if (permission[target]) { // Oddaję zgodę
+                permission[target] = false;
+                locks->ra_missing[resource]++;
+            }
+            Message ack = {.type = MSG_STEAL_ACK, .timestamp = locks->clock, .sender_rank = locks->my_rank,
+                           .house_id = resource};
+            lock_send(locks, &ack, target);
+        }
+        locks->deferred_count = 0;
+        lock_note_depths(locks);
+        return;
+    }
+
+    Message msg_steal_rel = {.type = MSG_STEAL_REL, .timestamp = locks->clock, .sender_rank = locks->my_rank,
+                             .house_id = resource, .mode = mode};
+    if (locks->num_servers > 0) { // Serwer nie potrzebuje TERMINATE - koniec wykrywa bariera
+        locks->house_granted = false;
+        lock_send(locks, &msg_steal_rel, resource % locks->num_servers);
+        return;
+    }
+    HouseState* house = &locks->houses[resource];
+    house->served[locks->my_rank] = locks->clock;
+    HouseProtocol next = house_decide(locks, resource, mode);
+    if (house->protocol == HOUSE_TOKEN) { // Bez REL: token do czekającego albo zostaje u mnie
+        if (next == HOUSE_LAMPORT) {
+            house_switch(locks, resource, HOUSE_LAMPORT);
+        } else {
+            house_pass_token(locks, resource);
+        }
+    } else if (next == HOUSE_TOKEN) {
+        house_switch(locks, resource, HOUSE_TOKEN); // Zamiast STEAL_REL
+        house_pass_token(locks, resource);
+    } else {
+        lock_send_all(locks, &msg_steal_rel);
+    }
+    if (last) {
+        // Koniec kradzieży doklejony do ostatniego STEAL_REL (albo SWITCH_*) zamiast osobnego TERMINATE do wszystkich
+        Message msg_terminate = {.type = MSG_TERMINATE, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1};
+        lock_send_all(locks, &msg_terminate);
+    }
+}
+
+// Proces nie będzie już ubiegał się o domy, choć jego ostatnie wyjście nie było last (agent lidera w na3.c
+// kończy, gdy cały węzeł skończył): osobny TERMINATE do wszystkich uczestników.
+static inline void lock_announce_finish(LockSet* locks) {
+    locks->clock++;
+    Message msg_terminate = {.type = MSG_TERMINATE, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1};
+    lock_send_all(locks, &msg_terminate);
+    lock_flush(locks);
+}
+
+// Koniec cyklu serwera: wolne domy i paserzy trafiają do najwcześniejszych żądań, przydziały idą jednym lock_flush.
+static inline void lock_server_grant(LockSet* locks) {
+    LockServer* server = locks->server;
+    for (int h = server->shard; h < server->num_houses; h += server->num_servers) {
+        // Oglądający z czoła kolejki wchodzą razem; kradnący - gdy dom jest pusty
+        RequestQueue* queue = &server->house_queues[h];
+        while (queue->size > 0 && server->house_holder[h] == -1) {
+            Request next = queue->heap[0];
+            if (next.mode == ACCESS_EXCLUSIVE && server->house_readers[h] > 0) break;
+            remove_from_queue_by_rank(queue, next.rank);
+            if (next.mode == ACCESS_SHARED) {
+                server->house_readers[h]++;
+            } else {
+                server->house_holder[h] = next.rank;
+            }
+            locks->clock++;
+            Message grant = {.type = MSG_GRANT, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = h};
+            lock_send(locks, &grant, next.rank);
+        }
+    }
+    int f;
+    while (server->fence_queue.size > 0 && (f = lock_server_idle_fence(server)) != -1) {
+        int rank = server->fence_queue.heap[0].rank;
+        remove_from_queue_by_rank(&server->fence_queue, rank);
+        server->fence_holder[f] = rank;
+        server->fence_of_rank[rank] = f;
+        locks->clock++;
+        Message grant = {.type = MSG_GRANT, .timestamp = locks->clock, .sender_rank = locks->my_rank, .house_id = -1,
+                         .request_number = f};
+        lock_send(locks, &grant, rank);
+    }
+    lock_note_depths(locks);
+    lock_flush(locks);
+}
+
+#ifndef LOCKSET_NO_MPI
+// Praca (sekcja albo odpoczynek) trwająca us mikrosekund. Z poll_us > 0 co tyle mikrosekund obsługuję
+// wiadomości, które przyszły w tym czasie - np. wolny token pasera od razu trafia do czekającego,
+// a kolejni oglądający dostają potwierdzenie i wchodzą razem ze mną.
+static inline void lock_work(LockSet* locks, int us, int poll_us) {
+    if (poll_us <= 0) {
+        usleep(us);
+        return;
+    }
+    double end = wall_time() + us / 1e6;
+    double now;
+    while ((now = wall_time()) < end) {
+        double left_us = (end - now) * 1e6;
+        usleep(left_us < poll_us ? (useconds_t)left_us : (useconds_t)poll_us);
+        lock_poll(locks);
+    }
+}
+
+// Odpoczynek (us mikrosekund). Z trzymaną dzierżawą co poll_us obsługuję wiadomości - cudze żądanie
+// odbiera ją od razu, więc czekający czeka najwyżej jedną operację i jeden takt; bez dzierżawy zwykły usleep.
+static inline void lock_idle(LockSet* locks, int us, int poll_us) {
+    double end = wall_time() + us / 1e6;
+    double now;
+    while (locks->lease_house != -1 && (now = wall_time()) < end) {
+        double left_us = (end - now) * 1e6;
+        usleep(left_us < poll_us ? (useconds_t)left_us : (useconds_t)poll_us);
+        lock_poll(locks);
+    }
+    now = wall_time();
+    if (now < end) usleep((useconds_t)((end - now) * 1e6));
+}
+
+// Transport MPI: nagłówki przez pulę MPI_Isend (zliczane do wykrywania zakończenia) i pierścień stałych
+// odbiorów, ładunki przez PayloadPool i MPI_Recv po nagłówku.
+typedef struct {
+    RecvEngine recv_engine;
+    SendPool send_pool;
+    PayloadPool payloads;
+} MpiTransport;
+
+static void mpi_transport_send(void* ctx, const Message* msgs, const int* targets, int count) {
+    MpiTransport* transport = ctx;
+    int slot = send_pool_take(&transport->send_pool);
+    for (int k = 0; k < count; k++) {
+        send_pool_post(&transport->send_pool, slot, &msgs[k], targets[k]);
+    }
+}
+
+static bool mpi_transport_try_recv(void* ctx, Message* msg) {
+    return recv_engine_try_next(&((MpiTransport*)ctx)->recv_engine, msg);
+}
+
+static void mpi_transport_recv(void* ctx, Message* msg) {
+    recv_engine_next(&((MpiTransport*)ctx)->recv_engine, msg);
+}
+
+static void mpi_transport_send_payload(void* ctx, const int* data, int count, int target, int tag) {
+    payload_send(&((MpiTransport*)ctx)->payloads, data, count, target, tag);
+}
+
+static void mpi_transport_recv_payload(void* ctx, int* data, int count, int source, int tag) {
+    (void)ctx;
+    MPI_Recv(data, count, MPI_INT, source, tag, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+}
+
+// Komplet procesu MPI: transport, skrzynka nadawcza, pula paserów, zbiór blokad i wykrywanie zakończenia.
+// Zbiór wskazuje na pozostałe pola, więc LockRuntime nie może się przenieść po lock_runtime_init.
+typedef struct {
+    Termination termination;
+    MpiTransport transport;
+    OutBox outbox;
+    FencePool fences;
+    LockSet locks;
+    bool stopping;        // Koniec własnych operacji już zgłoszony (termination_start)
+} LockRuntime;
+
+static void lock_runtime_init(LockRuntime* rt, int my_rank, int num_procs, int num_houses, int num_fences,
+                              BenchStats* stats, Trace* trace) {
+    termination_init(&rt->termination, num_procs);
+    recv_engine_init(&rt->transport.recv_engine, sizeof(Message), MPI_COMM_WORLD);
+    send_pool_init(&rt->transport.send_pool, sizeof(Message), num_procs, MPI_COMM_WORLD, &rt->termination);
+    payload_pool_init(&rt->transport.payloads, MPI_COMM_WORLD);
+    outbox_init(&rt->outbox, num_procs);
+    fence_pool_init(&rt->fences, num_fences, num_procs, my_rank);
+    LockTransport transport = {&rt->transport, mpi_transport_send, mpi_transport_try_recv, mpi_transport_recv,
+                               mpi_transport_send_payload, mpi_transport_recv_payload};
+    lock_set_init(&rt->locks, my_rank, num_procs, num_houses, &rt->fences, &rt->outbox, transport, stats, trace);
+    rt->stopping = false;
+}
+
+// Zgłasza koniec własnych operacji (bez czekania; drugi raz nic nie robi).
+static void lock_runtime_stop(LockRuntime* rt) {
+    if (rt->stopping) return;
+    rt->stopping = true;
+    termination_start(&rt->termination);
+}
+
+// Czeka na wiadomość albo na koniec bariery zakończenia; true = obsłużono wiadomość (odpowiedzi wysłane).
+static bool lock_runtime_wait(LockRuntime* rt) {
+    Message msg;
+    if (!recv_engine_next_or(&rt->transport.recv_engine, &rt->termination.barrier, &msg)) return false;
+    lock_dispatch(&rt->locks, &msg);
+    lock_flush(&rt->locks);
+    return true;
+}
+
+// Po ostatniej operacji: dopóki inni pracują (bariera zakończenia w toku), obsługuję wiadomości - inni mogą
+// potrzebować mojej zgody, potwierdzenia albo trzymanego tokenu (ta obsługa nie jest liczona w benchmarku).
+// Potem odbieram wiadomości jeszcze w drodze (tokenom i SWITCH_LAMPORT także ładunek) - do MPI_Finalize
+// nie zostaje nic niedoręczonego.
+static void lock_runtime_finish(LockRuntime* rt) {
+    rt->locks.stats = NULL;
+    lock_runtime_stop(rt);
+    while (lock_runtime_wait(rt)) {
+    }
+    long expected = termination_expected(&rt->termination);
+    int num_procs = rt->locks.num_procs;
+    int payload[2 + num_procs];
+    Message msg;
+    while (rt->transport.recv_engine.received < expected) {
+        recv_engine_next(&rt->transport.recv_engine, &msg);
+        int events = (1 << msg.type) | msg.piggyback;
+        if (events & (1 << MSG_FENCE_TOKEN)) {
+            MPI_Recv(payload, 2 + num_procs, MPI_INT, msg.sender_rank, FENCE_TOKEN_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+        if (events & (1 << MSG_HOUSE_TOKEN | 1 << MSG_SWITCH_LAMPORT)) {
+            MPI_Recv(payload, num_procs, MPI_INT, msg.sender_rank, HOUSE_TOKEN_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+    }
+}
+
+static void lock_runtime_free(LockRuntime* rt) {
+    send_pool_free(&rt->transport.send_pool);
+    payload_pool_free(&rt->transport.payloads);
+    recv_engine_free(&rt->transport.recv_engine);
+    lock_set_free(&rt->locks);
+    fence_pool_free(&rt->fences);
+    outbox_free(&rt->outbox);
+    termination_free(&rt->termination);
+}
+#endif // LOCKSET_NO_MPI
+
+#endif
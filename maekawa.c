@@ -0,0 +1,449 @@
+#include <mpi.h>         // MPI biblioteka do komunikacji międzyprocesowej
+#include <stdio.h>       // Standardowe wejście/wyjście (np. printf)
+#include <stdlib.h>      // Standardowe funkcje biblioteczne (np. rand, malloc)
+#include <string.h>      // Funkcje do operacji na stringach (nieużywane bezpośrednio, ale często przydatne)
+#include <unistd.h>      // Dla funkcji usleep (pauza)
+#include <time.h>        // Dla funkcji time() (inicjalizacja generatora liczb losowych)
+#include <stdbool.h>     // Dla typów bool, true, false
+#include "bench.h"       // Parametry obciążenia i pomiary benchmarku
+#include "trace.h"       // Binarny ślad zdarzeń i poziomy logowania (LOG_LEVEL)
+#include "metrics.h"     // Rejestr metryk protokołu (migawki --metrics-ms)
+#include "transport.h"   // Odbiór wiadomości na stałych żądaniach MPI (RecvEngine)
+
+#define NUM_HOUSES_TOTAL 2 // Całkowita liczba domów (domyślnie; --houses / BENCH_HOUSES)
+#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść (domyślnie; --ops / BENCH_OPS)
+
+#define LOCAL_INBOX_SIZE 16 // Pojemność skrzynki na wiadomości wysyłane do samego siebie
+
+// Typy wiadomości używane w komunikacji MPI (algorytm Maekawy z obsługą zakleszczeń)
+typedef enum {
+    MSG_REQ,         // Żądanie głosu od członka kworum (Request)
+    MSG_GRANT,       // Głos oddany na żądanie (Locked / Grant)
+    MSG_RELEASE,     // Zwolnienie głosu po wyjściu z sekcji krytycznej
+    MSG_INQUIRE,     // Arbiter pyta posiadacza głosu, czy może go oddać żądaniu o wyższym priorytecie
+    MSG_FAILED,      // Arbiter informuje, że żądanie musi poczekać na żądanie o wyższym priorytecie
+    MSG_YIELD,       // Odpowiedź na INQUIRE: oddaję głos (Relinquish)
+    MSG_TERMINATE    // Wiadomość informująca o zakończeniu pracy przez proces
+} MessageType;
+
+// Struktura wiadomości przesyłanej między procesami
+typedef struct {
+    MessageType type;      // Typ wiadomości (z enum MessageType)
+    int timestamp;         // Zegar Lamporta nadawcy wiadomości (dla MSG_REQ: timestamp żądania)
+    int sender_rank;       // Ranga (ID) procesu wysyłającego wiadomość
+} Message;
+
+// Struktura reprezentująca żądanie (priorytet wg timestampu, remisy wg rangi)
+typedef struct {
+    int timestamp;       // Zegar Lamporta żądania
+    int rank;            // Ranga (ID) procesu, który wysłał żądanie
+} Request;
+
+// Stan procesu w algorytmie Maekawy. Każdy proces jest jednocześnie arbitrem (głosuje na żądania
+// członków swojego kworum) i ubiegającym się (zbiera głosy od całego swojego kworum).
+typedef struct {
+    int my_rank;
+    int num_procs;
+    int clock;             // Zegar Lamporta
+
+    // Kworum: wiersz i kolumna procesu w siatce ceil(sqrt(N)) x ceil(sqrt(N)) (razem z nim samym)
+    int* quorum;
+    int quorum_size;
+
+    // Rola arbitra
+    bool voted;            // Czy mój głos jest aktualnie oddany
+    Request voted_for;     // Żądanie, na które oddałem głos
+    bool inquire_sent;     // Czy wysłałem już INQUIRE do posiadacza mojego głosu
+    Request* waiting;      // Żądania czekające na mój głos, posortowane wg priorytetu
+    int waiting_size;
+
+    // Rola ubiegającego się
+    bool requesting;       // Czy ubiegam się o sekcję krytyczną
+    Request my_request;    // Moje bieżące żądanie
+    bool* granted;         // granted[j]: mam głos arbitra j
+    int grants_count;
+    bool* failed_from;     // failed_from[j]: arbiter j przysłał FAILED (i jeszcze nie dał głosu)
+    int failed_count;
+    bool* yielded_to;      // yielded_to[j]: oddałem głos arbitra j (i jeszcze go nie odzyskałem)
+    int yielded_count;
+    bool* inquired_by;     // inquired_by[j]: arbiter j pyta (INQUIRE) o oddanie głosu
+
+    // Wiadomości wysłane do samego siebie (jestem członkiem własnego kworum)
+    Message local_inbox[LOCAL_INBOX_SIZE];
+    int inbox_head;
+    int inbox_size;
+
+    int active_quorum;     // Liczba innych członków kworum, którzy jeszcze nie zakończyli pracy
+    BenchStats* stats;     // Pomiary benchmarku (NULL po zakończeniu pomiaru)
+    Trace* trace;          // Ślad zdarzeń
+} Maekawa;
+
+// Prosta funkcja zwracająca większą z dwóch liczb.
+int max(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Zwraca true, jeśli żądanie a ma wyższy priorytet niż b (niższy timestamp, remisy wg rangi).
+bool request_before(Request a, Request b) {
+    return a.timestamp < b.timestamp || (a.timestamp == b.timestamp && a.rank < b.rank);
+}
+
+// Funkcja pomocnicza do zwracania nazwy typu wiadomości jako string (dla logowania).
+const char* get_message_type_name(MessageType type) {
+    switch (type) {
+        case MSG_REQ: return "ŻĄDANIE GŁOSU (REQ)";
+        case MSG_GRANT: return "GŁOS (GRANT)";
+        case MSG_RELEASE: return "ZWOLNIENIE GŁOSU (RELEASE)";
+        case MSG_INQUIRE: return "ZAPYTANIE O GŁOS (INQUIRE)";
+        case MSG_FAILED: return "ODMOWA (FAILED)";
+        case MSG_YIELD: return "ODDANIE GŁOSU (YIELD)";
+        case MSG_TERMINATE: return "ZAKOŃCZENIE PRACY (TERMINATE)";
+        default: return "NIEZNANY TYP";
+    }
+}
+
+// Buduje kworum w siatce k x k (k = ceil(sqrt(N))): wiersz i kolumna procesu.
+// Każde dwa takie kworum mają wspólny element, a ich rozmiar to około 2*sqrt(N) - 1.
+void build_grid_quorum(Maekawa* m) {
+    int k = 1;
+    while (k * k < m->num_procs) k++;
+    int my_row = m->my_rank / k;
+    int my_col = m->my_rank % k;
+
+    m->quorum = malloc(2 * k * sizeof(int));
+    m->quorum_size = 0;
+    for (int i = 0; i < m->num_procs; i++) {
+        if (i / k == my_row || i % k == my_col) {
+            m->quorum[m->quorum_size++] = i;
+        }
+    }
+}
+
+// Inicjalizuje stan algorytmu Maekawy.
+void maekawa_init(Maekawa* m, int my_rank, int num_procs, BenchStats* stats, Trace* trace) {
+    m->my_rank = my_rank;
+    m->num_procs = num_procs;
+    m->clock = 0;
+    build_grid_quorum(m);
+
+    m->voted = false;
+    m->inquire_sent = false;
+    m->waiting = malloc(num_procs * sizeof(Request));
+    m->waiting_size = 0;
+
+    m->requesting = false;
+    m->granted = calloc(num_procs, sizeof(bool));
+    m->failed_from = calloc(num_procs, sizeof(bool));
+    m->yielded_to = calloc(num_procs, sizeof(bool));
+    m->inquired_by = calloc(num_procs, sizeof(bool));
+    m->grants_count = 0;
+    m->failed_count = 0;
+    m->yielded_count = 0;
+
+    m->inbox_head = 0;
+    m->inbox_size = 0;
+    m->active_quorum = m->quorum_size - 1;
+    m->stats = stats;
+    m->trace = trace;
+}
+
+// Zwalnia pamięć stanu algorytmu.
+void maekawa_free(Maekawa* m) {
+    free(m->quorum);
+    free(m->waiting);
+    free(m->granted);
+    free(m->failed_from);
+    free(m->yielded_to);
+    free(m->inquired_by);
+}
+
+// Wysyła wiadomość do procesu target. Wiadomości do samego siebie trafiają do lokalnej skrzynki.
+void send_message(Maekawa* m, int target, MessageType type, int timestamp) {
+    Message msg_out = {type, timestamp, m->my_rank};
+    if (target == m->my_rank) {
+        m->local_inbox[(m->inbox_head + m->inbox_size) % LOCAL_INBOX_SIZE] = msg_out;
+        m->inbox_size++;
+    } else {
+        MPI_Send(&msg_out, sizeof(Message), MPI_BYTE, target, 0, MPI_COMM_WORLD);
+        bench_message_sent(m->stats, type, 0); // Wiadomości do siebie nie idą przez sieć
+    }
+    trace_event(m->trace, TRACE_SEND, timestamp, target, type, -1);
+}
+
+// Wysyła wiadomość do wszystkich członków mojego kworum (również do siebie).
+void send_to_quorum(Maekawa* m, MessageType type, int timestamp) {
+    for (int i = 0; i < m->quorum_size; i++) {
+        send_message(m, m->quorum[i], type, timestamp);
+    }
+}
+
+// Zwraca kolejną wiadomość: najpierw z lokalnej skrzynki, potem z sieci (blokująco).
+Message next_message(Maekawa* m, RecvEngine* engine) {
+    if (m->inbox_size > 0) {
+        Message msg = m->local_inbox[m->inbox_head];
+        m->inbox_head = (m->inbox_head + 1) % LOCAL_INBOX_SIZE;
+        m->inbox_size--;
+        return msg;
+    }
+    Message msg;
+    recv_engine_next(engine, &msg);
+    return msg;
+}
+
+// Nieblokująca wersja next_message.
+bool try_next_message(Maekawa* m, RecvEngine* engine, Message* msg) {
+    if (m->inbox_size > 0) {
+        *msg = next_message(m, engine);
+        return true;
+    }
+    return recv_engine_try_next(engine, msg);
+}
+
+// --- ROLA ARBITRA ---
+
+// Wstawia żądanie do posortowanej listy oczekujących (lista ma co najwyżej rozmiar kworum)
+// i zwraca jego pozycję.
+int site_enqueue(Maekawa* m, Request req) {
+    int i = m->waiting_size;
+    while (i > 0 && request_before(req, m->waiting[i - 1])) {
+        m->waiting[i] = m->waiting[i - 1];
+        i--;
+    }
+    m->waiting[i] = req;
+    m->waiting_size++;
+    return i;
+}
+
+// Oddaje głos na żądanie req.
+void site_grant(Maekawa* m, Request req) {
+    m->voted = true;
+    m->voted_for = req;
+    m->inquire_sent = false;
+    m->clock++; // Zdarzenie lokalne: wysłanie głosu
+    send_message(m, req.rank, MSG_GRANT, m->clock);
+}
+
+// Oddaje głos pierwszemu oczekującemu żądaniu (jeśli jest).
+void site_grant_next(Maekawa* m) {
+    m->voted = false;
+    m->inquire_sent = false;
+    if (m->waiting_size == 0) return;
+
+    Request next = m->waiting[0];
+    for (int i = 1; i < m->waiting_size; i++) {
+        m->waiting[i - 1] = m->waiting[i];
+    }
+    m->waiting_size--;
+    site_grant(m, next);
+}
+
+// Obsługa żądania głosu.
+void site_on_request(Maekawa* m, Request req) {
+    if (!m->voted) {
+        site_grant(m, req);
+        return;
+    }
+
+    int pos = site_enqueue(m, req);
+    if (pos == 0 && request_before(req, m->voted_for)) {
+        // Nowe żądanie ma najwyższy priorytet: pytam posiadacza głosu, czy go odda.
+        // Poprzedni pierwszy oczekujący (jeśli wyprzedzał posiadacza głosu) nie dostał jeszcze FAILED.
+        if (m->waiting_size > 1 && request_before(m->waiting[1], m->voted_for)) {
+            m->clock++;
+            send_message(m, m->waiting[1].rank, MSG_FAILED, m->clock);
+        }
+        if (!m->inquire_sent) {
+            m->clock++;
+            send_message(m, m->voted_for.rank, MSG_INQUIRE, m->clock);
+            m->inquire_sent = true;
+        }
+    } else {
+        // Żądanie musi poczekać na żądanie o wyższym priorytecie
+        m->clock++;
+        send_message(m, req.rank, MSG_FAILED, m->clock);
+    }
+}
+
+// --- ROLA UBIEGAJĄCEGO SIĘ ---
+
+// Oddaje arbitrowi j jego głos (odpowiedź YIELD na INQUIRE).
+void requester_yield(Maekawa* m, int j) {
+    m->inquired_by[j] = false;
+    m->granted[j] = false;
+    m->grants_count--;
+    m->yielded_to[j] = true;
+    m->yielded_count++;
+    m->clock++;
+    send_message(m, j, MSG_YIELD, m->clock);
+}
+
+// Jeśli wiem, że nie wejdę teraz do sekcji (dostałem FAILED lub już oddałem jakiś głos),
+// oddaję głosy wszystkim arbitrom, którzy o to pytali.
+void requester_yield_inquired(Maekawa* m) {
+    if (m->failed_count == 0 && m->yielded_count == 0) return;
+    for (int i = 0; i < m->quorum_size; i++) {
+        int j = m->quorum[i];
+        if (m->inquired_by[j] && m->granted[j]) {
+            requester_yield(m, j);
+        }
+    }
+}
+
+// Przetwarza odebraną wiadomość (w roli arbitra albo ubiegającego się).
+void handle_message(Maekawa* m, Message msg_in) {
+    // Aktualizacja zegara Lamporta na podstawie odebranej wiadomości
+    m->clock = max(m->clock, msg_in.timestamp) + 1;
+    int j = msg_in.sender_rank;
+    if (j != m->my_rank) bench_message_received(m->stats, msg_in.type, 0);
+    trace_event(m->trace, TRACE_RECV, m->clock, j, msg_in.type, -1);
+    LOG(2, "--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d (ts=%d). Głosy: %d/%d\n", m->my_rank, m->clock, get_message_type_name(msg_in.type), j, msg_in.timestamp, m->grants_count, m->quorum_size);
+
+    if (msg_in.type == MSG_REQ) {
+        Request req = {msg_in.timestamp, j};
+        site_on_request(m, req);
+    } else if (msg_in.type == MSG_RELEASE) {
+        if (m->voted && m->voted_for.rank == j) {
+            site_grant_next(m);
+        }
+    } else if (msg_in.type == MSG_YIELD) {
+        // Posiadacz głosu go oddał: jego żądanie wraca do kolejki, głos dostaje pierwszy oczekujący
+        if (m->voted && m->voted_for.rank == j) {
+            site_enqueue(m, m->voted_for);
+            site_grant_next(m);
+        }
+    } else if (msg_in.type == MSG_GRANT) {
+        m->granted[j] = true;
+        m->grants_count++;
+        m->inquired_by[j] = false;
+        if (m->failed_from[j]) { m->failed_from[j] = false; m->failed_count--; }
+        if (m->yielded_to[j]) { m->yielded_to[j] = false; m->yielded_count--; }
+    } else if (msg_in.type == MSG_FAILED) {
+        if (!m->failed_from[j]) { m->failed_from[j] = true; m->failed_count++; }
+        requester_yield_inquired(m);
+    } else if (msg_in.type == MSG_INQUIRE) {
+        // Pytanie dotyczy mojego bieżącego żądania tylko wtedy, gdy nadal mam głos tego arbitra
+        if (m->requesting && m->granted[j]) {
+            m->inquired_by[j] = true;
+            requester_yield_inquired(m);
+        }
+    } else if (msg_in.type == MSG_TERMINATE) {
+        m->active_quorum--;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int my_rank, num_procs; // Ranga bieżącego procesu i całkowita liczba procesów
+    MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);    // Pobranie rangi bieżącego procesu
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);  // Pobranie całkowitej liczby procesów
+
+    Workload workload; // Parametry obciążenia (linia poleceń / zmienne środowiskowe)
+    workload_init(&workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, 1);
+    BenchStats stats; // Pomiary benchmarku
+    bench_init(&stats, workload.operations);
+
+    // Ślad zdarzeń (zapisywany tylko przy --trace-dir / TRACE_DIR)
+    const char* message_names[MSG_TERMINATE + 1];
+    for (int t = 0; t <= MSG_TERMINATE; t++) message_names[t] = get_message_type_name(t);
+    Trace trace;
+    trace_init(&trace, argc, argv, "maekawa", my_rank, num_procs, message_names, MSG_TERMINATE + 1);
+    static Metrics metrics; // Rejestr metryk (liczniki zawsze, migawki przy --metrics-ms / BENCH_METRICS_MS)
+    metrics_init(&metrics, argc, argv, "maekawa", my_rank, num_procs, message_names, MSG_TERMINATE + 1, 0);
+    stats.metrics = &metrics;
+
+    Maekawa m; // Stan algorytmu Maekawy (zegar, kworum, stan arbitra i ubiegającego się)
+    maekawa_init(&m, my_rank, num_procs, &stats, &trace);
+
+    RecvEngine recv_engine; // Silnik odbioru wiadomości (stałe żądania odbioru)
+    recv_engine_init(&recv_engine, sizeof(Message), MPI_COMM_WORLD);
+
+    // Inicjalizacja generatora liczb losowych (stałe ziarno daje powtarzalne obciążenie)
+    srand(workload.seed >= 0 ? (unsigned)(workload.seed + my_rank) : (unsigned)(my_rank * time(NULL)));
+
+    bench_start(&stats); // Wspólny początek pomiaru
+    metrics_start(&metrics);
+
+    // Główna pętla symulująca operacje kradzieży
+    for (int op_count = 0; op_count < workload.operations; op_count++) {
+        // --- PRÓBA WEJŚCIA DO SEKCJI KRYTYCZNEJ ---
+        LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Kworum: %d procesów.\n", my_rank, m.clock, op_count + 1, m.quorum_size);
+
+        m.clock++; // Zdarzenie lokalne: inkrementacja zegara Lamporta
+        m.requesting = true;
+        m.my_request.timestamp = m.clock;
+        m.my_request.rank = my_rank;
+        int target_house_id = (my_rank + op_count) % workload.houses; // Symboliczny wybór domu do okradzenia
+        bench_request(&stats, 0, false); // Jedna sekcja krytyczna dla wszystkich domów
+        trace_event(&trace, TRACE_CS_REQUEST, m.clock, -1, -1, target_house_id);
+        for (int i = 0; i < m.quorum_size; i++) { // Wyczyszczenie stanu poprzedniego żądania (tylko kworum)
+            int j = m.quorum[i];
+            m.granted[j] = m.failed_from[j] = m.yielded_to[j] = m.inquired_by[j] = false;
+        }
+        m.grants_count = m.failed_count = m.yielded_count = 0;
+
+        send_to_quorum(&m, MSG_REQ, m.my_request.timestamp); // Żądanie tylko do kworum zamiast do wszystkich
+        LOG(2, "--- Proces %d --- [Zegar: %d] Wysłałem **%s** (ts=%d) do %d członków kworum.\n", my_rank, m.clock, get_message_type_name(MSG_REQ), m.my_request.timestamp, m.quorum_size);
+
+        // Pętla oczekiwania na głosy całego kworum
+        while (m.grants_count < m.quorum_size) {
+            Message msg_in = next_message(&m, &recv_engine);
+            handle_message(&m, msg_in);
+        }
+
+        // --- WEJŚCIE DO SEKCJI KRYTYCZNEJ ---
+        m.clock++; // Zdarzenie lokalne: inkrementacja zegara
+        bench_enter(&stats);
+        trace_event(&trace, TRACE_CS_ENTER, m.clock, -1, -1, target_house_id);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, m.clock, target_house_id);
+
+        usleep(workload_random_us(workload.cs_min_us, workload.cs_max_us)); // Symulacja czasu trwania kradzieży
+
+        // --- WYJŚCIE Z SEKCJI KRYTYCZNEJ ---
+        m.clock++; // Zdarzenie lokalne: inkrementacja zegara
+        m.requesting = false;
+        bench_exit(&stats);
+        trace_event(&trace, TRACE_CS_EXIT, m.clock, -1, -1, target_house_id);
+        send_to_quorum(&m, MSG_RELEASE, m.clock);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Wysłałem **%s** do kworum.\n", my_rank, m.clock, get_message_type_name(MSG_RELEASE));
+
+        // Obsłużenie zaległych wiadomości (m.in. własnego RELEASE), aby nie blokować głosu na czas odpoczynku
+        Message msg_in;
+        while (try_next_message(&m, &recv_engine, &msg_in)) {
+            handle_message(&m, msg_in);
+        }
+
+        LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d. Odpoczywam przed kolejną próbą.\n", my_rank, m.clock, op_count + 1);
+        trace_flush(&trace); // Zrzut śladu poza sekcją krytyczną i pętlą oczekiwania
+        metrics_tick(&metrics, m.clock); // Migawki za minione okresy
+        usleep(workload_random_us(workload.think_min_us, workload.think_max_us)); // Symulacja odpoczynku
+    }
+    bench_finish(&stats); // Koniec pomiaru
+    m.stats = NULL; // Dalsze wiadomości (TERMINATE, głosowanie dla innych) są poza pomiarem
+
+    // Po zakończeniu wszystkich operacji, proces informuje członków kworum o swoim zakończeniu.
+    // Kworum są symetryczne (ten sam wiersz lub kolumna), więc tylko oni mogą jeszcze potrzebować mojego głosu.
+    trace_event(&trace, TRACE_FINISH, m.clock, -1, -1, -1);
+    for (int i = 0; i < m.quorum_size; i++) {
+        if (m.quorum[i] != my_rank) {
+            send_message(&m, m.quorum[i], MSG_TERMINATE, m.clock);
+        }
+    }
+    LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Głosuję, dopóki kworum pracuje.\n", my_rank, m.clock);
+
+    while (m.active_quorum > 0) { // Dalej pełnię rolę arbitra dla członków kworum, którzy nie skończyli
+        Message msg_in = next_message(&m, &recv_engine);
+        handle_message(&m, msg_in);
+    }
+    LOG(1, "--- Proces %d --- [Zegar: %d] Całe kworum zakończyło pracę. Finalizuję pracę.\n", my_rank, m.clock);
+
+    MPI_Barrier(MPI_COMM_WORLD); // Bariera, aby upewnić się, że wszystkie procesy doszły do tego punktu przed finalizacją
+    metrics_finish(&metrics, m.clock); // Migawka końcowa (operacja zbiorowa)
+    bench_report(&stats, &workload, "maekawa", my_rank, num_procs); // Raport benchmarku (proces 0; operacja zbiorowa)
+    bench_free(&stats);
+    metrics_free(&metrics);
+    trace_close(&trace); // Zrzut reszty śladu przed MPI_Finalize
+    recv_engine_free(&recv_engine); // Zwolnienie stałych żądań odbioru
+    maekawa_free(&m);
+    MPI_Finalize(); // Zakończenie pracy środowiska MPI
+    return 0;
+}
@@ -0,0 +1,274 @@
+// Rejestr metryk protokołu procesu (wspólny dla nowa.c, na3.c i mpi.c) - zawsze włączony, tani.
+// Liczniki: wiadomości wysłane i odebrane według typu (MessageType), bieżąca i największa głębokość
+// kolejek (żądań kradzieży, żądań paserów, odłożonych ACK), czas oczekiwania na sekcję i czas w sekcji,
+// zegar Lamporta. Każdy licznik to atomowy long w osobnej linii pamięci podręcznej: wątek postępu
+// (nowa.c) i agent (na3.c) aktualizują je bez blokad i bez fałszywego współdzielenia z wątkiem roboczym.
+//
+// Migawki (--metrics-ms=N lub BENCH_METRICS_MS=N, domyślnie 0 = bez migawek): co N ms od wspólnego
+// początku pomiaru każdy proces oddaje wektor liczników do MPI_Ireduce (suma i maksimum) na własnym
+// komunikatorze. Nie czeka na innych - proces 0 wypisuje migawkę na stderr, gdy redukcja się zakończy
+// u wszystkich. Proces zajęty dłużej (sekcja, oczekiwanie) dosyła zaległe migawki przy najbliższym
+// metrics_tick, a metrics_finish wyrównuje ich liczbę między procesami i dodaje migawkę końcową.
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "walltime.h"
+
+#define METRICS_MAX_MSG_TYPES 16
+#define METRICS_NAME_LEN 32
+#define METRICS_CACHE_LINE 64
+
+// Licznik w osobnej linii pamięci podręcznej (sizeof == METRICS_CACHE_LINE)
+typedef struct {
+    _Alignas(METRICS_CACHE_LINE) atomic_long value;
+} MetricCounter;
+
+// Kolejki, których głębokość jest śledzona
+typedef enum {
+    METRIC_STEAL_QUEUE,   // Żądania sekcji kradzieży (w mpi.c suma po domach)
+    METRIC_FENCE_QUEUE,   // Żądania paserów (mpi.c)
+    METRIC_DEFERRED,      // Odłożone odpowiedzi ACK (nowa.c)
+    METRIC_QUEUE_COUNT
+} MetricQueue;
+
+// Migawka w toku: wektor liczników procesu i bufory redukcji (u procesu 0)
+typedef struct {
+    long* local;
+    long* sum;
+    long* max;
+    MPI_Request requests[2];
+    bool final;
+} MetricsSnapshot;
+
+typedef struct Metrics {
+    MetricCounter sent[METRICS_MAX_MSG_TYPES];
+    MetricCounter received[METRICS_MAX_MSG_TYPES];
+    MetricCounter depth[METRIC_QUEUE_COUNT];
+    MetricCounter depth_max[METRIC_QUEUE_COUNT];
+    MetricCounter wait_us;    // Czas od żądania do wejścia do sekcji (mikrosekundy)
+    MetricCounter cs_us;      // Czas w sekcji
+    MetricCounter clock;      // Zegar Lamporta z ostatniego metrics_tick
+
+    // Migawki - tylko wątek wywołujący metrics_tick/metrics_finish (MPI)
+    double interval;          // Okres migawek w sekundach (0 = bez migawek)
+    double start_time;        // Początek pomiaru (wall_time)
+    MPI_Comm comm;            // Własny komunikator redukcji (nie miesza się z innymi operacjami zbiorowymi)
+    MetricsSnapshot* pending; // Migawki oddane do redukcji, jeszcze niewypisane (bufor pierścieniowy)
+    int pending_first, pending_count, pending_capacity;
+    int issued;               // Liczba oddanych migawek
+    long last_clock_sum;      // Suma zegarów z poprzedniej wypisanej migawki (tempo zegara)
+    double last_elapsed;
+    int rank, num_procs;
+    unsigned queues;          // Maska 1 << MetricQueue kolejek, które program ma
+    int msg_type_count;
+    char msg_type_names[METRICS_MAX_MSG_TYPES][METRICS_NAME_LEN];
+    char program[32];
+} Metrics;
+
+// Długość wektora migawki: wysłane, odebrane, głębokości, maksima, czasy, zegar i chwila migawki (ms)
+static inline int metrics_vector_length(const Metrics* m) {
+    return 2 * m->msg_type_count + 2 * METRIC_QUEUE_COUNT + 4;
+}
+
+// Krótka nazwa typu: "żądanie KRADZIEŻY (STEAL_REQ)" -> "STEAL_REQ".
+static void metrics_short_name(char* out, const char* name) {
+    const char* open = strrchr(name, '(');
+    const char* close = open ? strchr(open, ')') : NULL;
+    if (open && close) {
+        int len = (int)(close - open - 1);
+        if (len >= METRICS_NAME_LEN) len = METRICS_NAME_LEN - 1;
+        memcpy(out, open + 1, len);
+        out[len] = '\0';
+    } else {
+        snprintf(out, METRICS_NAME_LEN, "%s", name);
+    }
+}
+
+// Inicjalizacja rejestru (operacja zbiorowa: MPI_Comm_dup). queues = maska 1 << MetricQueue.
+static void metrics_init(Metrics* m, int argc, char** argv, const char* program, int rank, int num_procs,
+                         const char* const* msg_type_names, int msg_type_count, unsigned queues) {
+    for (int t = 0; t < METRICS_MAX_MSG_TYPES; t++) {
+        atomic_init(&m->sent[t].value, 0);
+        atomic_init(&m->received[t].value, 0);
+    }
+    for (int q = 0; q < METRIC_QUEUE_COUNT; q++) {
+        atomic_init(&m->depth[q].value, 0);
+        atomic_init(&m->depth_max[q].value, 0);
+    }
+    atomic_init(&m->wait_us.value, 0);
+    atomic_init(&m->cs_us.value, 0);
+    atomic_init(&m->clock.value, 0);
+
+    const char* value = getenv("BENCH_METRICS_MS");
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--metrics-ms=", 13) == 0) value = argv[i] + 13;
+    }
+    m->interval = value && value[0] ? atoi(value) / 1000.0 : 0.0;
+    m->start_time = wall_time();
+    m->pending = NULL;
+    m->pending_first = m->pending_count = m->pending_capacity = 0;
+    m->issued = 0;
+    m->last_clock_sum = 0;
+    m->last_elapsed = 0.0;
+    m->rank = rank;
+    m->num_procs = num_procs;
+    m->queues = queues;
+    m->msg_type_count = msg_type_count < METRICS_MAX_MSG_TYPES ? msg_type_count : METRICS_MAX_MSG_TYPES;
+    for (int t = 0; t < m->msg_type_count; t++) metrics_short_name(m->msg_type_names[t], msg_type_names[t]);
+    snprintf(m->program, sizeof(m->program), "%s", program);
+    MPI_Comm_dup(MPI_COMM_WORLD, &m->comm);
+}
+
+static inline void metrics_count(MetricCounter* counters, int type) {
+    if (type >= 0 && type < METRICS_MAX_MSG_TYPES) {
+        atomic_fetch_add_explicit(&counters[type].value, 1, memory_order_relaxed);
+    }
+}
+
+static inline void metrics_add_time(MetricCounter* counter, double seconds) {
+    atomic_fetch_add_explicit(&counter->value, (long)(seconds * 1e6), memory_order_relaxed);
+}
+
+// Nowa głębokość kolejki queue (m == NULL: bez rejestru).
+static inline void metrics_depth(Metrics* m, MetricQueue queue, long depth) {
+    if (!m) return;
+    atomic_store_explicit(&m->depth[queue].value, depth, memory_order_relaxed);
+    long seen = atomic_load_explicit(&m->depth_max[queue].value, memory_order_relaxed);
+    while (depth > seen &&
+           !atomic_compare_exchange_weak_explicit(&m->depth_max[queue].value, &seen, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+// Wypisuje migawkę (proces 0): sumy po procesach, maksima głębokości i tempo zegara od poprzedniej.
+static void metrics_print(Metrics* m, const MetricsSnapshot* s) {
+    int T = m->msg_type_count;
+    const long* sum = s->sum;
+    const long* max = s->max;
+    int q0 = 2 * T, qmax0 = q0 + METRIC_QUEUE_COUNT, rest = qmax0 + METRIC_QUEUE_COUNT;
+    double elapsed = max[rest + 3] / 1000.0;
+
+    char line[1024];
+    int len = snprintf(line, sizeof(line), "metryki %s t=%.2fs%s wysłane/odebrane:", m->program, elapsed,
+                       s->final ? " (koniec)" : "");
+    int shown = 0;
+    for (int t = 0; t < T && len < (int)sizeof(line); t++) {
+        if (sum[t] == 0 && sum[T + t] == 0) continue;
+        len += snprintf(line + len, sizeof(line) - len, " %s=%ld/%ld", m->msg_type_names[t], sum[t], sum[T + t]);
+        shown++;
+    }
+    if (!shown && len < (int)sizeof(line)) len += snprintf(line + len, sizeof(line) - len, " -");
+    static const char* queue_names[METRIC_QUEUE_COUNT] = {"kolejka kradzieży", "kolejka paserów", "odłożone ACK"};
+    for (int q = 0; q < METRIC_QUEUE_COUNT && len < (int)sizeof(line); q++) {
+        if (!(m->queues & (1u << q))) continue;
+        len += snprintf(line + len, sizeof(line) - len, " | %s %ld (max %ld)", queue_names[q], sum[q0 + q], max[qmax0 + q]);
+    }
+    double wait_ms = sum[rest] / 1000.0, cs_ms = sum[rest + 1] / 1000.0;
+    if (len < (int)sizeof(line)) {
+        len += snprintf(line + len, sizeof(line) - len,
+                        " | oczekiwanie %.1f ms, w sekcji %.1f ms (%.0f%% oczekiwania) | zegar max %ld",
+                        wait_ms, cs_ms, wait_ms + cs_ms > 0 ? 100.0 * wait_ms / (wait_ms + cs_ms) : 0.0,
+                        max[rest + 2]);
+    }
+    double dt = elapsed - m->last_elapsed; // Tempo: średni przyrost zegara procesu na sekundę
+    if (dt > 0 && len < (int)sizeof(line)) {
+        snprintf(line + len, sizeof(line) - len, ", %.0f/s", (sum[rest + 2] - m->last_clock_sum) / (double)m->num_procs / dt);
+    }
+    fprintf(stderr, "%s\n", line);
+    m->last_clock_sum = sum[rest + 2];
+    m->last_elapsed = elapsed;
+}
+
+// Zabiera zakończone migawki (w kolejności oddania); wait = czeka na wszystkie.
+static void metrics_complete(Metrics* m, bool wait) {
+    while (m->pending_count > 0) {
+        MetricsSnapshot* s = &m->pending[m->pending_first];
+        if (wait) {
+            MPI_Waitall(2, s->requests, MPI_STATUSES_IGNORE);
+        } else {
+            int done;
+            MPI_Testall(2, s->requests, &done, MPI_STATUSES_IGNORE);
+            if (!done) return;
+        }
+        if (m->rank == 0) metrics_print(m, s);
+        free(s->local);
+        free(s->sum);
+        free(s->max);
+        m->pending_first = (m->pending_first + 1) % m->pending_capacity;
+        m->pending_count--;
+    }
+}
+
+// Oddaje bieżące liczniki do redukcji (nie czeka).
+static void metrics_issue(Metrics* m, int clock, bool final) {
+    if (m->pending_count == m->pending_capacity) { // Powiększenie bufora (żądania MPI zostają w miejscu buforów)
+        int capacity = m->pending_capacity ? 2 * m->pending_capacity : 8;
+        MetricsSnapshot* pending = malloc(capacity * sizeof(MetricsSnapshot));
+        for (int i = 0; i < m->pending_count; i++) {
+            pending[i] = m->pending[(m->pending_first + i) % m->pending_capacity];
+        }
+        free(m->pending);
+        m->pending = pending;
+        m->pending_first = 0;
+        m->pending_capacity = capacity;
+    }
+    MetricsSnapshot* s = &m->pending[(m->pending_first + m->pending_count) % m->pending_capacity];
+    m->pending_count++;
+    m->issued++;
+
+    atomic_store_explicit(&m->clock.value, clock, memory_order_relaxed);
+    int n = metrics_vector_length(m), T = m->msg_type_count, k = 0;
+    s->local = malloc(n * sizeof(long));
+    s->sum = malloc(n * sizeof(long));
+    s->max = malloc(n * sizeof(long));
+    s->final = final;
+    for (int t = 0; t < T; t++) s->local[k++] = atomic_load_explicit(&m->sent[t].value, memory_order_relaxed);
+    for (int t = 0; t < T; t++) s->local[k++] = atomic_load_explicit(&m->received[t].value, memory_order_relaxed);
+    for (int q = 0; q < METRIC_QUEUE_COUNT; q++) s->local[k++] = atomic_load_explicit(&m->depth[q].value, memory_order_relaxed);
+    for (int q = 0; q < METRIC_QUEUE_COUNT; q++) s->local[k++] = atomic_load_explicit(&m->depth_max[q].value, memory_order_relaxed);
+    s->local[k++] = atomic_load_explicit(&m->wait_us.value, memory_order_relaxed);
+    s->local[k++] = atomic_load_explicit(&m->cs_us.value, memory_order_relaxed);
+    s->local[k++] = clock;
+    s->local[k++] = (long)((wall_time() - m->start_time) * 1000.0);
+    MPI_Ireduce(s->local, s->sum, n, MPI_LONG, MPI_SUM, 0, m->comm, &s->requests[0]);
+    MPI_Ireduce(s->local, s->max, n, MPI_LONG, MPI_MAX, 0, m->comm, &s->requests[1]);
+}
+
+// Początek pomiaru (po bench_start): od tej chwili liczą się okresy migawek.
+static void metrics_start(Metrics* m) {
+    m->start_time = wall_time();
+}
+
+// Wywoływane co jakiś czas przez wątek roboczy: oddaje migawki za minione okresy, wypisuje zakończone.
+static void metrics_tick(Metrics* m, int clock) {
+    if (m->interval <= 0) return;
+    double elapsed = wall_time() - m->start_time;
+    while ((m->issued + 1) * m->interval <= elapsed) {
+        metrics_issue(m, clock, false);
+    }
+    metrics_complete(m, false);
+}
+
+// Koniec pracy (operacja zbiorowa, po wykryciu zakończenia): wyrównanie liczby migawek, migawka końcowa.
+static void metrics_finish(Metrics* m, int clock) {
+    if (m->interval > 0) {
+        int issued_max = 0;
+        MPI_Allreduce(&m->issued, &issued_max, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        while (m->issued < issued_max) metrics_issue(m, clock, false);
+        metrics_issue(m, clock, true);
+        metrics_complete(m, true);
+    }
+}
+
+static void metrics_free(Metrics* m) {
+    free(m->pending);
+    MPI_Comm_free(&m->comm);
+}
+
+#endif
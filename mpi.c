@@ -5,88 +5,16 @@
 #include <unistd.h> // For usleep
 #include <time.h>   // For time()
 #include <stdbool.h> // For bool, true, false
+#include "lockset.h" // Protokoły domów i paserów, transport MPI, pomiary, ślad i metryki
 
+// Wartości domyślne; można je zmienić przez --houses/--fences/--ops (lub BENCH_HOUSES/BENCH_FENCES/BENCH_OPS)
 #define NUM_HOUSES_TOTAL 3 // Przykładowa łączna liczba domów (zasobów)
 #define P_FENCES 7        // Liczba dostępnych paserów
 #define NUM_OPERATIONS 2    // Ile razy każdy złodziej spróbuje coś ukraść i spieniężyć
-
-// Typy wiadomości
-typedef enum {
-    MSG_STEAL_REQ,
-    MSG_STEAL_REL,
-    MSG_FENCE_REQ,
-    MSG_FENCE_REL,
-    MSG_FENCE_ACK,   // Wiadomość potwierdzająca żądanie pasera
-    MSG_TERMINATE    // Nowy typ wiadomości o zakończeniu pracy procesu
-} MessageType;
-
-// Struktura wiadomości
-typedef struct {
-    MessageType type;
-    int timestamp;
-    int sender_rank;
-} Message;
-
-// Struktura żądania w kolejce
-typedef struct {
-    int timestamp;
-    int rank;
-} Request;
-
-// Funkcja pomocnicza do sortowania żądań (wg timestamp, potem wg rank)
-int compare_requests(const void* a, const void* b) {
-    Request* r_a = (Request*)a;
-    Request* r_b = (Request*)b;
-    if (r_a->timestamp != r_b->timestamp) {
-        return r_a->timestamp - r_b->timestamp;
-    }
-    return r_a->rank - r_b->rank;
-}
-
-void add_to_queue(Request queue[], int* size, Request req) {
-    queue[*size] = req;
-    (*size)++;
-    qsort(queue, *size, sizeof(Request), compare_requests);
-}
-
-void remove_from_queue_by_rank(Request queue[], int* size, int rank_to_remove) {
-    int i, j;
-    for (i = 0; i < *size; i++) {
-        if (queue[i].rank == rank_to_remove) {
-            for (j = i; j < (*size) - 1; j++) {
-                queue[j] = queue[j + 1];
-            }
-            (*size)--;
-            return;
-        }
-    }
-}
-
-int find_my_request_index(Request queue[], int size, int my_rank) {
-    for (int i = 0; i < size; i++) {
-        if (queue[i].rank == my_rank) {
-            return i;
-        }
-    }
-    return -1; // Not found
-}
-
-int max(int a, int b) {
-    return a > b ? a : b;
-}
-
-// Funkcja pomocnicza do zwracania nazwy typu wiadomości
-const char* get_message_type_name(MessageType type) {
-    switch (type) {
-        case MSG_STEAL_REQ: return "żądanie KRADZIEŻY (STEAL_REQ)";
-        case MSG_STEAL_REL: return "zwolnienie KRADZIEŻY (STEAL_REL)";
-        case MSG_FENCE_REQ: return "żądanie PASERA (FENCE_REQ)";
-        case MSG_FENCE_REL: return "zwolnienie PASERA (FENCE_REL)";
-        case MSG_FENCE_ACK: return "potwierdzenie PASERA (FENCE_ACK)";
-        case MSG_TERMINATE: return "ZAKOŃCZENIE PRACY (TERMINATE)";
-        default: return "NIEZNANY TYP";
-    }
-}
+#define POLL_US 1000        // Co ile mikrosekund pracy obsługiwać wiadomości (--poll-us; 0 = dopiero w pętli oczekiwania)
+#define NUM_SERVERS 0       // Liczba procesów-serwerów blokad (--servers; 0 = algorytm rozproszony)
+#define ADAPT_WINDOW 4      // Tryb adaptacyjny (--adaptive=1): co tyle moich wyjść z domu decyzja o jego protokole (--adapt-window)
+#define ADAPT_HIGH 2        // Średnio tylu czekających przy wyjściu przełącza dom z tokenu na Lamporta (--adapt-high)
 
 int main(int argc, char* argv[]) {
     int my_rank, num_procs;
@@ -94,250 +22,145 @@ int main(int argc, char* argv[]) {
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
-    int clock = 0;
-    Request steal_requests_queue[num_procs];
-    int steal_requests_queue_size = 0;
-    Request fence_requests_queue[num_procs];
-    int fence_requests_queue_size = 0;
-
-    int highest_ts_received_steal[num_procs];
-    int highest_ts_received_fence[num_procs];
-    bool fence_ack_received[num_procs]; // Do śledzenia potwierdzeń dla pasera
-    bool is_active[num_procs];           // Do śledzenia aktywnych procesów
-
-    for(int i=0; i<num_procs; ++i) {
-        highest_ts_received_steal[i] = 0;
-        highest_ts_received_fence[i] = 0;
-        fence_ack_received[i] = false;
-        is_active[i] = true; // Na początku wszystkie procesy są aktywne
+    Workload workload;
+    workload_init(&workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, P_FENCES);
+    BenchStats stats;
+    bench_init(&stats, workload.operations);
+
+    // Tryb potokowy (--pipeline-fence=1, domyślny): żądanie pasera wychodzi już po wejściu do sekcji
+    // kradzieży, więc token zwykle czeka gotowy, gdy kradzież się kończy. Zakleszczenia nie ma -
+    // o pasera prosi tylko ten, kto już jest w sekcji kradzieży i na nic więcej w niej nie czeka.
+    bool pipeline_fence = bench_int_option(argc, argv, "pipeline-fence", "BENCH_PIPELINE_FENCE", 1) != 0;
+    int poll_us = bench_int_option(argc, argv, "poll-us", "BENCH_POLL_US", POLL_US); // 0 = zwykły usleep
+
+    // Tryb serwerów blokad: przynajmniej jeden proces musi zostać złodziejem
+    int num_servers = bench_int_option(argc, argv, "servers", "BENCH_SERVERS", NUM_SERVERS);
+    if (num_servers < 0) num_servers = 0;
+    if (num_servers > 0 && num_servers >= num_procs) {
+        if (my_rank == 0) fprintf(stderr, "--servers=%d przy %d procesach - serwerów będzie %d.\n", num_servers, num_procs, num_procs - 1);
+        num_servers = num_procs - 1;
+    }
+    bool is_server = my_rank < num_servers;
+
+    // Tryb adaptacyjny: protokół każdego domu (kolejka Lamporta albo token) wg obserwowanej rywalizacji.
+    // Domami w trybie serwerów rządzą serwery, więc tam go nie ma.
+    bool adaptive = bench_int_option(argc, argv, "adaptive", "BENCH_ADAPTIVE", 0) != 0;
+    if (adaptive && num_servers > 0) {
+        if (my_rank == 0) fprintf(stderr, "--adaptive z --servers - domy zostają u serwerów.\n");
+        adaptive = false;
+    }
+    const char* program_names[2][2] = {{"mpi-sequential", "mpi"}, {"mpi-sequential+servers", "mpi+servers"}};
+    char program[32];
+    snprintf(program, sizeof(program), "%s%s", program_names[num_servers > 0][pipeline_fence], adaptive ? "+adaptive" : "");
+
+    const char* message_names[MSG_TERMINATE + 1];
+    for (int t = 0; t <= MSG_TERMINATE; t++) message_names[t] = get_message_type_name(t);
+    Trace trace;
+    trace_init(&trace, argc, argv, program, my_rank, num_procs, message_names, MSG_TERMINATE + 1);
+    static Metrics metrics; // Liczniki zawsze, migawki przy --metrics-ms / BENCH_METRICS_MS
+    metrics_init(&metrics, argc, argv, program, my_rank, num_procs, message_names, MSG_TERMINATE + 1,
+                 1u << METRIC_STEAL_QUEUE | 1u << METRIC_FENCE_QUEUE);
+    stats.metrics = &metrics;
+
+    // W trybie serwerów bez tokenów paserów - paserów rozdają serwery
+    static LockRuntime rt; // Zbiór blokad wskazuje na pola rt - nie może się przenieść
+    lock_runtime_init(&rt, my_rank, num_procs, workload.houses, num_servers > 0 ? 0 : workload.fences, &stats, &trace);
+    LockSet* locks = &rt.locks;
+    LockServer server;
+    if (is_server) {
+        lock_server_init(&server, my_rank, num_procs, num_servers, workload.houses, workload.fences);
+    }
+    if (num_servers > 0) {
+        lock_set_use_servers(locks, num_servers, workload.fences, is_server ? &server : NULL);
+    }
+    if (adaptive) {
+        locks->adapt_window = bench_int_option(argc, argv, "adapt-window", "BENCH_ADAPT_WINDOW", ADAPT_WINDOW);
+        locks->adapt_high = bench_int_option(argc, argv, "adapt-high", "BENCH_ADAPT_HIGH", ADAPT_HIGH);
     }
 
-    srand(my_rank * time(NULL)); // Różne ziarna dla różnych procesów
-
-    for (int op_count = 0; op_count < NUM_OPERATIONS; op_count++) {
-        // --- SEKCJA KRADZIEŻY ---
-        printf("--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Zwiększam zegar.\n", my_rank, clock, op_count + 1);
-
-        clock++;
-        int target_house_id = (my_rank + op_count) % NUM_HOUSES_TOTAL;
-
-        clock++;
-        Request my_steal_req = {clock, my_rank};
-        add_to_queue(steal_requests_queue, &steal_requests_queue_size, my_steal_req);
-        
-        Message msg_out_steal = {MSG_STEAL_REQ, my_steal_req.timestamp, my_rank};
-        for (int i = 0; i < num_procs; i++) {
-            if (i != my_rank) {
-                MPI_Send(&msg_out_steal, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
-        }
-        // printf("--- Proces %d --- [Zegar: %d] Wysłałem **%s** z moim czasem (ts=%d) do wszystkich innych procesów.\n", my_rank, clock, get_message_type_name(MSG_STEAL_REQ), my_steal_req.timestamp);
-
-        while (true) { 
-            int my_idx_steal = find_my_request_index(steal_requests_queue, steal_requests_queue_size, my_rank);
-            
-            bool can_enter_steal_cs = (my_idx_steal == 0 && steal_requests_queue_size > 0);
-            if (can_enter_steal_cs) { 
-                // printf("--- Proces %d --- [Zegar: %d] Sprawdzam, czy moje żądanie kradzieży (ts=%d, rank=%d) jest na czele kolejki.\n", my_rank, clock, my_steal_req.timestamp, my_rank);
-                for (int i = 0; i < num_procs; i++) { 
-                    if (i == my_rank || !is_active[i]) continue; // Nie czekaj na nieaktywne procesy
-
-                    bool received_later_message_from_i =
-                        (highest_ts_received_steal[i] > my_steal_req.timestamp) ||
-                        (highest_ts_received_steal[i] == my_steal_req.timestamp && i > my_rank);
-
-                    if (!received_later_message_from_i) {
-                        can_enter_steal_cs = false; 
-                        // printf("--- Proces %d --- [Zegar: %d] Muszę czekać na odpowiedź od procesu %d lub na późniejsze żądanie. Nie mogę wejść do sekcji kradzieży.\n", my_rank, clock, i);
-                        break;
-                    }
-                }
-            }
-
-            if (can_enter_steal_cs) {
-                break; 
-            }
-
-            // Użyj MPI_Iprobe do nieblokującego sprawdzenia wiadomości w pętli kradzieży
-            int flag;
-            MPI_Status status;
-            MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, &status);
-
-            if (flag) {
-                Message msg_in;
-                MPI_Recv(&msg_in, sizeof(Message), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
-                
-                clock = max(clock, msg_in.timestamp) + 1;
-                printf("--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d z timestampem (ts=%d). Aktualizuję zegar.\n", my_rank, clock, get_message_type_name(msg_in.type), msg_in.sender_rank, msg_in.timestamp);
-
-                if (msg_in.type == MSG_STEAL_REQ || msg_in.type == MSG_STEAL_REL) {
-                    highest_ts_received_steal[msg_in.sender_rank] = max(highest_ts_received_steal[msg_in.sender_rank], msg_in.timestamp);
-                } else if (msg_in.type == MSG_FENCE_REQ || msg_in.type == MSG_FENCE_REL || msg_in.type == MSG_FENCE_ACK) {
-                    highest_ts_received_fence[msg_in.sender_rank] = max(highest_ts_received_fence[msg_in.sender_rank], msg_in.timestamp);
-                }
-
-                if (msg_in.type == MSG_STEAL_REQ) {
-                    Request new_req = {msg_in.timestamp, msg_in.sender_rank};
-                    add_to_queue(steal_requests_queue, &steal_requests_queue_size, new_req);
-                } else if (msg_in.type == MSG_STEAL_REL) {
-                    remove_from_queue_by_rank(steal_requests_queue, &steal_requests_queue_size, msg_in.sender_rank);
-                } else if (msg_in.type == MSG_FENCE_REQ) { 
-                    Request new_req = {msg_in.timestamp, msg_in.sender_rank};
-                    add_to_queue(fence_requests_queue, &fence_requests_queue_size, new_req);
-                    clock++;
-                    Message msg_ack = {MSG_FENCE_ACK, clock, my_rank};
-                    MPI_Send(&msg_ack, sizeof(Message), MPI_BYTE, msg_in.sender_rank, 0, MPI_COMM_WORLD);
-                    // printf("--- Proces %d --- [Zegar: %d] Wysłałem **%s** (ts=%d) do procesu %d w odpowiedzi na żądanie pasera.\n", my_rank, clock, get_message_type_name(MSG_FENCE_ACK), clock, msg_in.sender_rank);
-                } else if (msg_in.type == MSG_FENCE_REL) {
-                    remove_from_queue_by_rank(fence_requests_queue, &fence_requests_queue_size, msg_in.sender_rank);
-                } else if (msg_in.type == MSG_FENCE_ACK) {
-                    fence_ack_received[msg_in.sender_rank] = true;
-                } else if (msg_in.type == MSG_TERMINATE) { // Obsługa wiadomości TERMINATE
-                    is_active[msg_in.sender_rank] = false;
-                }
-            } else {
-                usleep(1000); // Krótka pauza
-            }
-        }
-
-        clock++;
-        printf("--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, clock, target_house_id);
-
-        usleep((rand() % 100 + 50) * 1000); 
-
-        clock++;
-        remove_from_queue_by_rank(steal_requests_queue, &steal_requests_queue_size, my_rank);
-        
-        Message msg_steal_rel = {MSG_STEAL_REL, clock, my_rank};
-        for (int i = 0; i < num_procs; i++) {
-            if (i != my_rank) {
-                MPI_Send(&msg_steal_rel, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
+    srand(workload.seed >= 0 ? (unsigned)(workload.seed + my_rank) : (unsigned)(my_rank * time(NULL))); // Różne ziarna dla różnych procesów
+
+    bench_start(&stats);
+    metrics_start(&metrics);
+
+    if (is_server) {
+        // Serwer nie kradnie: od razu zgłasza koniec własnych operacji i obsługuje złodziei, dopóki
+        // bariera zakończenia trwa. Cykl: czekam na wiadomość, zabieram resztę tych, które już przyszły,
+        // przydzielam wolne zasoby.
+        lock_runtime_stop(&rt);
+        while (lock_runtime_wait(&rt)) {
+            lock_poll(locks);
+            lock_server_grant(locks);
+            if (trace.count > TRACE_CAPACITY / 2) trace_flush(&trace); // Rzadko - to gorąca ścieżka serwera
+            metrics_tick(&metrics, locks->clock);
         }
-        printf("--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Wysłałem wiadomość **%s** (ts=%d) do wszystkich innych procesów.\n", my_rank, clock, get_message_type_name(MSG_STEAL_REL), clock);
-
-        // --- SEKCJA PASERA ---
-        printf("--- Proces %d --- [Zegar: %d] Rozpoczynam próbę zajęcia pasera (aby spieniężyć skradzione dobra).\n", my_rank, clock);
+        bench_finish(&stats);
+        trace_event(&trace, TRACE_FINISH, locks->clock, -1, -1, -1);
+    }
 
-        for (int i = 0; i < num_procs; ++i) {
-            if (i != my_rank) {
-                fence_ack_received[i] = false;
-            }
+    for (int op_count = 0; op_count < workload.operations && !is_server; op_count++) {
+        // --- SEKCJA KRADZIEŻY ---
+        LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Zwiększam zegar.\n", my_rank, locks->clock, op_count + 1);
+        locks->clock++;
+        int target_house_id = (my_rank + op_count) % workload.houses;
+        // Część operacji tylko ogląda dom (--read-pct): sekcja współdzielona, bez pasera
+        AccessMode mode = workload_random_read(&workload) ? ACCESS_SHARED : ACCESS_EXCLUSIVE;
+
+        while (!lock_try_acquire(locks, target_house_id, mode)) {
+            lock_wait(locks);
         }
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, locks->clock, target_house_id);
 
-        clock++;
-        Request my_fence_req = {clock, my_rank};
-        add_to_queue(fence_requests_queue, &fence_requests_queue_size, my_fence_req);
-        
-        Message msg_out_fence = {MSG_FENCE_REQ, my_fence_req.timestamp, my_rank};
-        for (int i = 0; i < num_procs; i++) {
-            if (i != my_rank) {
-                MPI_Send(&msg_out_fence, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
+        if (pipeline_fence && mode == ACCESS_EXCLUSIVE) {
+            lock_request(locks, RESOURCE_FENCE, ACCESS_EXCLUSIVE); // Wejście sprawdzę po kradzieży
+            LOG(1, "--- Proces %d --- [Zegar: %d] Już teraz proszę o pasera (tryb potokowy).\n", my_rank, locks->clock);
         }
-        // printf("--- Proces %d --- [Zegar: %d] Wysłałem **%s** z moim czasem (ts=%d) do wszystkich innych procesów.\n", my_rank, clock, get_message_type_name(MSG_FENCE_REQ), my_fence_req.timestamp);
-
-        while (true) { 
-            int my_idx_fence = find_my_request_index(fence_requests_queue, fence_requests_queue_size, my_rank);
-            
-            bool can_enter_fence_cs = (my_idx_fence != -1 && my_idx_fence < P_FENCES);
-            
-            if (can_enter_fence_cs) { 
-                // Zliczenie potrzebnych i otrzymanych ACK
-                int acks_needed = 0;
-                int acks_count = 0;
-                for (int i = 0; i < num_procs; ++i) {
-                    if (i == my_rank) continue;
-                    if (is_active[i]) { // Liczymy ACK tylko od AKTYWNYCH procesów
-                        acks_needed++;
-                        if (fence_ack_received[i]) {
-                            acks_count++;
-                        }
-                    }
-                }
-                
-                if (acks_count >= acks_needed) { // Wszyscy aktywni odpowiedzieli
-                    printf("--- Proces %d --- [Zegar: %d] Wszystkie warunki spełnione. Wchodzę do sekcji krytycznej pasera.\n", my_rank, clock);
-                    break; 
-                } else {
-                    // printf("--- Proces %d --- [Zegar: %d] Czekam na %d potwierdzeń (ACK) od aktywnych procesów. Otrzymałem %d. Nie mogę wejść do sekcji pasera.\n", my_rank, clock, acks_needed, acks_count);
-                }
-            }
 
-            // Użyj MPI_Iprobe do nieblokującego sprawdzenia wiadomości
-            int flag;
-            MPI_Status status;
-            MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, &status);
+        lock_work(locks, workload_random_us(workload.cs_min_us, workload.cs_max_us), poll_us);
 
-            if (flag) { // Wiadomość jest dostępna
-                Message msg_in;
-                MPI_Recv(&msg_in, sizeof(Message), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status);
-                
-                clock = max(clock, msg_in.timestamp) + 1;
-                // printf("--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d z timestampem (ts=%d). Aktualizuję zegar.\n", my_rank, clock, get_message_type_name(msg_in.type), msg_in.sender_rank, msg_in.timestamp);
-                
-                if (msg_in.type == MSG_STEAL_REQ || msg_in.type == MSG_STEAL_REL) {
-                       highest_ts_received_steal[msg_in.sender_rank] = max(highest_ts_received_steal[msg_in.sender_rank], msg_in.timestamp);
-                } else if (msg_in.type == MSG_FENCE_REQ || msg_in.type == MSG_FENCE_REL || msg_in.type == MSG_FENCE_ACK) {
-                       highest_ts_received_fence[msg_in.sender_rank] = max(highest_ts_received_fence[msg_in.sender_rank], msg_in.timestamp);
-                }
+        lock_release(locks, target_house_id, op_count == workload.operations - 1);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Wysyłam wiadomość **%s** (ts=%d) do wszystkich innych procesów.\n", my_rank, locks->clock, get_message_type_name(MSG_STEAL_REL), locks->clock);
 
-                if (msg_in.type == MSG_FENCE_REQ) {
-                    Request new_req = {msg_in.timestamp, msg_in.sender_rank};
-                    add_to_queue(fence_requests_queue, &fence_requests_queue_size, new_req);
-                    clock++;
-                    Message msg_ack = {MSG_FENCE_ACK, clock, my_rank};
-                    MPI_Send(&msg_ack, sizeof(Message), MPI_BYTE, msg_in.sender_rank, 0, MPI_COMM_WORLD);
-                    // printf("--- Proces %d --- [Zegar: %d] Wysłałem **%s** (ts=%d) do procesu %d w odpowiedzi na żądanie pasera.\n", my_rank, clock, get_message_type_name(MSG_FENCE_ACK), clock, msg_in.sender_rank);
-                } else if (msg_in.type == MSG_FENCE_REL) {
-                    remove_from_queue_by_rank(fence_requests_queue, &fence_requests_queue_size, msg_in.sender_rank);
-                } else if (msg_in.type == MSG_FENCE_ACK) {
-                    fence_ack_received[msg_in.sender_rank] = true;
-                } else if (msg_in.type == MSG_STEAL_REQ) { 
-                    Request new_req = {msg_in.timestamp, msg_in.sender_rank};
-                    add_to_queue(steal_requests_queue, &steal_requests_queue_size, new_req);
-                } else if (msg_in.type == MSG_STEAL_REL) {
-                    remove_from_queue_by_rank(steal_requests_queue, &steal_requests_queue_size, msg_in.sender_rank);
-                } else if (msg_in.type == MSG_TERMINATE) { // Obsługa wiadomości TERMINATE
-                    is_active[msg_in.sender_rank] = false;
-                }
-            } else {
-                // Brak wiadomości, proces może wykonać inną pracę lub po prostu poczekać chwilę
-                usleep(1000); // Krótka pauza, aby uniknąć zajętego oczekiwania
+        // --- SEKCJA PASERA --- (po oględzinach nie ma czego spieniężać)
+        if (mode == ACCESS_SHARED) {
+            lock_flush(locks);
+        } else {
+            LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam próbę zajęcia pasera (aby spieniężyć skradzione dobra).\n", my_rank, locks->clock);
+            while (!lock_try_acquire(locks, RESOURCE_FENCE, ACCESS_EXCLUSIVE)) { // W trybie sekwencyjnym FENCE_REQ doklejone do STEAL_REL
+                lock_wait(locks);
             }
-        }
-
-        clock++;
-        printf("--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ PASERA! *** Spieniężam skradzione dobra. Moja pozycja w kolejce: %d.\n", my_rank, clock, find_my_request_index(fence_requests_queue, fence_requests_queue_size, my_rank));
+            int fence_id = rt.fences.in_use;
+            LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ PASERA! *** Spieniężam skradzione dobra u pasera %d.\n", my_rank, locks->clock, fence_id);
 
-        usleep((rand() % 80 + 30) * 1000); 
+            lock_work(locks, workload_random_us(workload.fence_min_us, workload.fence_max_us), poll_us);
 
-        clock++;
-        remove_from_queue_by_rank(fence_requests_queue, &fence_requests_queue_size, my_rank);
-        
-        Message msg_fence_rel = {MSG_FENCE_REL, clock, my_rank};
-        for (int i = 0; i < num_procs; i++) {
-            if (i != my_rank) {
-                MPI_Send(&msg_fence_rel, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
+            lock_release(locks, RESOURCE_FENCE, false);
+            lock_flush(locks);
+            LOG(1, "--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ PASERA %d. ***\n", my_rank, locks->clock, fence_id);
         }
-        printf("--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ PASERA. *** Wysłałem wiadomość **%s** (ts=%d) do wszystkich innych procesów.\n", my_rank, clock, get_message_type_name(MSG_FENCE_REL), clock);
 
-        printf("--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d (kradzież i spieniężenie). Odpoczywam przed kolejną próbą.\n", my_rank, clock, op_count + 1);
-        usleep((rand() % 50) * 1000); 
+        LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d (kradzież i spieniężenie). Odpoczywam przed kolejną próbą.\n", my_rank, locks->clock, op_count + 1);
+        trace_flush(&trace); // Poza sekcjami krytycznymi i pętlami oczekiwania
+        metrics_tick(&metrics, locks->clock);
+        lock_work(locks, workload_random_us(workload.think_min_us, workload.think_max_us), poll_us);
     }
-
-    // Przed MPI_Finalize, wyślij wiadomość TERMINATE do wszystkich
-    Message msg_terminate = {MSG_TERMINATE, clock, my_rank};
-    for (int i = 0; i < num_procs; i++) {
-        if (i != my_rank) {
-            MPI_Send(&msg_terminate, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-        }
+    if (!is_server) {
+        bench_finish(&stats);
+        trace_event(&trace, TRACE_FINISH, locks->clock, -1, -1, -1);
     }
-    printf("--- Proces %d --- [Zegar: %d] Wysłałem wiadomość **%s** do wszystkich innych procesów przed zakończeniem.\n", my_rank, clock, get_message_type_name(MSG_TERMINATE));
-
-    printf("--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży i spieniężania. Finalizuję pracę.\n", my_rank, clock);
-    MPI_Barrier(MPI_COMM_WORLD); // Upewnij się, że wszystkie procesy dojdą do tego punktu
+    // Dopóki inni pracują, trzymane tokeny paserów i domów muszą trafiać do czekających
+    lock_runtime_finish(&rt);
+
+    LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży i spieniężania. Finalizuję pracę.\n", my_rank, locks->clock);
+    metrics_finish(&metrics, locks->clock);
+    bench_report(&stats, &workload, program, my_rank, num_procs);
+    bench_free(&stats);
+    metrics_free(&metrics);
+    trace_close(&trace);
+    if (is_server) {
+        lock_server_free(&server);
+    }
+    lock_runtime_free(&rt);
     MPI_Finalize();
     return 0;
-}
\ No newline at end of file
+}
@@ -5,226 +5,525 @@
 #include <unistd.h>   // Dla funkcji usleep (pauza)
 #include <time.h>     // Dla funkcji time() (inicjalizacja generatora liczb losowych)
 #include <stdbool.h>  // Dla typów bool, true, false
+#include <sched.h>    // Dla sched_yield (aktywne oczekiwanie w blokadach MCS i węzła)
+#include <pthread.h>  // Dla wątku agenta węzła (blokada hierarchiczna)
+#include <stdatomic.h> // Dla atomowych pól blokady węzła w pamięci współdzielonej
+#include "bench.h"    // Parametry obciążenia i pomiary benchmarku
+#include "trace.h"    // Binarny ślad zdarzeń i poziomy logowania (LOG_LEVEL)
+#include "lockset.h"  // Algorytm Lamporta (zbiór blokad z jednym zasobem), transport MPI i wykrywanie zakończenia
 
-#define NUM_HOUSES_TOTAL 5 // Całkowita liczba domów
-#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść
+#define NUM_HOUSES_TOTAL 5 // Całkowita liczba domów (domyślnie; --houses / BENCH_HOUSES)
+#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść (domyślnie; --ops / BENCH_OPS)
+#define MCS_HOME 0         // Proces, w którego oknie RMA leży ogon kolejki MCS
+#define NODE_BATCH 4       // Ile wejść węzła z rzędu pod jednym wejściem lidera do sekcji globalnej (--node-batch / BENCH_NODE_BATCH)
+#define READ_POLL_US 500   // Co ile mikrosekund oglądający w sekcji (i dzierżawca w czasie odpoczynku) obsługuje wiadomości
+#define LEASE_OPS 1        // Najwięcej operacji pod jednym żądaniem sekcji (1 = bez dzierżawy; dzierżawa na życzenie: --lease-ops / BENCH_LEASE_OPS)
+#define LEASE_MS 100       // Najdłuższy czas dzierżawy w milisekundach (--lease-ms / BENCH_LEASE_MS)
 
-// Typy wiadomości używane w komunikacji MPI
-typedef enum {
-    MSG_STEAL_REQ,    // Żądanie wejścia do sekcji krytycznej "kradzież"
-    MSG_STEAL_REL,    // Zwolnienie sekcji krytycznej "kradzież"
-    MSG_TERMINATE     // Wiadomość informująca o zakończeniu pracy przez proces
-} MessageType;
+// Blokada kolejkowa MCS na oknie RMA (MPI_Win) - ta sama sekcja krytyczna bez wymiany wiadomości.
+// Każdy proces wystawia w oknie trzy liczby: ogon kolejki (używany tylko u MCS_HOME), rangę następcy
+// i flagę "czekam". Wejście to jedna atomowa zamiana ogona (MPI_Fetch_and_op) i, gdy kolejka nie była
+// pusta, wpisanie się u poprzednika; potem proces kręci się wyłącznie na własnej, lokalnej fladze.
+// Przekazanie blokady to jeden zdalny zapis flagi następcy - bez udziału jego procesora, gdy okno leży
+// w pamięci współdzielonej albo sieć obsługuje RDMA. Wszystkie odczyty i zapisy pól okna są operacjami
+// atomowymi MPI (MPI_Fetch_and_op / MPI_Accumulate / MPI_Compare_and_swap) w jednej epoce MPI_Win_lock_all.
+enum { MCS_TAIL, MCS_NEXT, MCS_LOCKED, MCS_FIELDS };
 
-// Struktura wiadomości przesyłanej między procesami
 typedef struct {
-    MessageType type;    // Typ wiadomości (z enum MessageType)
-    int timestamp;       // Zegar Lamporta nadawcy wiadomości
-    int sender_rank;     // Ranga (ID) procesu wysyłającego wiadomość
-} Message;
+    MPI_Win win;
+    int* base;          // Lokalna część okna (MCS_FIELDS liczb)
+    int my_rank;
+    int clock;          // Licznik zdarzeń lokalnych (dla śladu; bez wiadomości nie ma zegara Lamporta)
+    BenchStats* stats;  // Zdalne operacje RMA są liczone jako wiadomości
+    Trace* trace;
+} McsLock;
 
-// Struktura reprezentująca żądanie w kolejce (dla algorytmu Lamporta)
-typedef struct {
-    int timestamp;       // Zegar Lamporta żądania
-    int rank;            // Ranga (ID) procesu, który wysłał żądanie
-} Request;
-
-// Funkcja pomocnicza do sortowania żądań w kolejce
-// Sortuje najpierw wg timestampu, a w przypadku remisów wg rangi procesu.
-int compare_requests(const void* a, const void* b) {
-    Request* r_a = (Request*)a;
-    Request* r_b = (Request*)b;
-    if (r_a->timestamp != r_b->timestamp) {
-        return r_a->timestamp - r_b->timestamp; // Rosnąco wg timestampu
-    }
-    return r_a->rank - r_b->rank; // Rosnąco wg rangi
-}
-
-// Dodaje żądanie do kolejki i utrzymuje ją posortowaną.
-void add_to_queue(Request queue[], int* size, Request req) {
-    queue[*size] = req; // Dodaj na koniec
-    (*size)++;          // Zwiększ rozmiar kolejki
-    qsort(queue, *size, sizeof(Request), compare_requests); // Posortuj kolejkę
-}
-
-// Usuwa żądanie z kolejki na podstawie rangi procesu.
-void remove_from_queue_by_rank(Request queue[], int* size, int rank_to_remove) {
-    int i, j;
-    for (i = 0; i < *size; i++) {
-        if (queue[i].rank == rank_to_remove) { // Znaleziono żądanie do usunięcia
-            for (j = i; j < (*size) - 1; j++) {
-                queue[j] = queue[j + 1]; // Przesuń elementy w lewo
-            }
-            (*size)--; // Zmniejsz rozmiar kolejki
+void mcs_init(McsLock* mcs, int my_rank, BenchStats* stats, Trace* trace) {
+    MPI_Win_allocate(MCS_FIELDS * sizeof(int), sizeof(int), MPI_INFO_NULL, MPI_COMM_WORLD, &mcs->base, &mcs->win);
+    mcs->base[MCS_TAIL] = -1; // Pusta kolejka
+    mcs->base[MCS_NEXT] = -1;
+    mcs->base[MCS_LOCKED] = 0;
+    mcs->my_rank = my_rank;
+    mcs->clock = 0;
+    mcs->stats = stats;
+    mcs->trace = trace;
+    MPI_Barrier(MPI_COMM_WORLD); // Okna wszystkich procesów zainicjalizowane przed pierwszym dostępem
+    MPI_Win_lock_all(0, mcs->win);
+}
+
+// Atomowy odczyt pola okna procesu target.
+int mcs_read(McsLock* mcs, int target, int field) {
+    int value;
+    MPI_Fetch_and_op(NULL, &value, MPI_INT, target, field, MPI_NO_OP, mcs->win);
+    MPI_Win_flush(target, mcs->win);
+    return value;
+}
+
+// Atomowy zapis pola okna procesu target.
+void mcs_write(McsLock* mcs, int target, int field, int value) {
+    MPI_Accumulate(&value, 1, MPI_INT, target, field, 1, MPI_INT, MPI_REPLACE, mcs->win);
+    MPI_Win_flush(target, mcs->win);
+    if (target != mcs->my_rank && mcs->stats) mcs->stats->messages_sent++;
+}
+
+// Kręci się na własnym polu, dopóki ma wartość value (przy nadmiarze procesów oddaje procesor).
+int mcs_wait_while(McsLock* mcs, int field, int value) {
+    int current;
+    while ((current = mcs_read(mcs, mcs->my_rank, field)) == value) {
+        sched_yield();
+    }
+    return current;
+}
+
+int mcs_acquire(McsLock* mcs, int house_id) {
+    mcs->clock++;
+    bench_request(mcs->stats, 0, false);
+    trace_event(mcs->trace, TRACE_CS_REQUEST, mcs->clock, -1, -1, house_id);
+
+    mcs_write(mcs, mcs->my_rank, MCS_NEXT, -1);
+    mcs_write(mcs, mcs->my_rank, MCS_LOCKED, 1);
+
+    // Dopisanie się na koniec kolejki: atomowa zamiana ogona
+    int predecessor;
+    MPI_Fetch_and_op(&mcs->my_rank, &predecessor, MPI_INT, MCS_HOME, MCS_TAIL, MPI_REPLACE, mcs->win);
+    MPI_Win_flush(MCS_HOME, mcs->win);
+    if (MCS_HOME != mcs->my_rank && mcs->stats) mcs->stats->messages_sent++;
+
+    if (predecessor != -1) {
+        mcs_write(mcs, predecessor, MCS_NEXT, mcs->my_rank); // Poprzednik przekaże mi blokadę
+        mcs_wait_while(mcs, MCS_LOCKED, 1);
+    }
+
+    mcs->clock++;
+    bench_enter(mcs->stats);
+    trace_event(mcs->trace, TRACE_CS_ENTER, mcs->clock, predecessor, -1, house_id);
+    return mcs->clock;
+}
+
+void mcs_release(McsLock* mcs, int house_id, bool last) {
+    (void)last; // Blokada MCS nie potrzebuje informacji o końcu pracy
+    bench_exit(mcs->stats);
+    mcs->clock++;
+    trace_event(mcs->trace, TRACE_CS_EXIT, mcs->clock, -1, -1, house_id);
+
+    int successor = mcs_read(mcs, mcs->my_rank, MCS_NEXT);
+    if (successor == -1) {
+        // Nikt się nie wpisał: próbuję opróżnić kolejkę (ogon wciąż wskazuje na mnie?)
+        int swapped_out = -1;
+        int empty = -1;
+        MPI_Compare_and_swap(&empty, &mcs->my_rank, &swapped_out, MPI_INT, MCS_HOME, MCS_TAIL, mcs->win);
+        MPI_Win_flush(MCS_HOME, mcs->win);
+        if (MCS_HOME != mcs->my_rank && mcs->stats) mcs->stats->messages_sent++;
+        if (swapped_out == mcs->my_rank) {
+            LOG(1, "--- Proces %d --- *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Kolejka MCS pusta.\n", mcs->my_rank);
             return;
         }
+        // Ktoś właśnie zamienił ogon - czekam, aż wpisze się u mnie jako następca
+        successor = mcs_wait_while(mcs, MCS_NEXT, -1);
     }
+    mcs_write(mcs, successor, MCS_LOCKED, 0); // Przekazanie blokady: jeden zdalny zapis
+    LOG(1, "--- Proces %d --- *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Blokadę MCS przejmuje proces %d.\n", mcs->my_rank, successor);
 }
 
-// Znajduje indeks własnego żądania w kolejce.
-int find_my_request_index(Request queue[], int size, int my_rank) {
-    for (int i = 0; i < size; i++) {
-        if (queue[i].rank == my_rank) {
-            return i; // Zwraca indeks, jeśli znaleziono
+void mcs_free(McsLock* mcs) {
+    MPI_Win_unlock_all(mcs->win);
+    MPI_Win_free(&mcs->win);
+}
+
+// Blokada hierarchiczna (dwupoziomowa): procesy jednego węzła (MPI_Comm_split_type z MPI_COMM_TYPE_SHARED)
+// ustawiają się w kolejce biletowej w oknie pamięci współdzielonej (MPI_Win_allocate_shared) - bez wiadomości.
+// Sekcję globalną (algorytm Lamporta) zdobywa dla całego węzła tylko lider węzła, więc ruch między węzłami
+// rośnie z liczbą węzłów, a nie procesów. Proces z blokadą węzła, który zastaje węzeł bez sekcji globalnej,
+// prosi o nią lidera i czeka. Wychodząc, przekazuje sekcję globalną następnemu czekającemu z węzła (bez
+// wiadomości), dopóki węzeł nie wykorzysta NODE_BATCH wejść z rzędu - wtedy lider ją zwalnia, żeby inne węzły
+// nie głodowały. Lider obsługuje algorytm Lamporta w osobnym wątku agenta, bo sam też kradnie i śpi w sekcji.
+typedef struct {
+    atomic_int next_ticket;     // Następny bilet do wydania
+    atomic_int now_serving;     // Bilet procesu, który ma blokadę węzła
+    atomic_int global_held;     // Węzeł jest w sekcji globalnej (lider wszedł i jeszcze jej nie zwolnił)
+    atomic_int want_global;     // Właściciel blokady węzła prosi lidera o sekcję globalną
+    atomic_int release_global;  // Właściciel blokady węzła prosi lidera o zwolnienie sekcji globalnej
+    atomic_int finished;        // Liczba procesów węzła, które zakończyły wszystkie operacje
+    int batch;                  // Wejścia węzła pod bieżącym wejściem do sekcji globalnej (chronione blokadą węzła)
+} NodeShared;
+
+typedef struct {
+    MPI_Comm node_comm;   // Procesy węzła
+    MPI_Win win;          // Okno pamięci współdzielonej z NodeShared (u lidera)
+    NodeShared* shared;
+    int node_rank, node_size;
+    int batch_limit;      // NODE_BATCH
+    int clock;            // Licznik zdarzeń lokalnych (dla śladu)
+    LockSet* locks;       // Algorytm Lamporta między liderami (tylko u lidera; zasób 0)
+    pthread_t agent;      // Wątek agenta lidera
+    BenchStats* stats;
+    Trace* trace;
+} HierLock;
+
+// Czeka (oddając procesor), aż pole będzie miało wartość różną od value.
+void hier_wait_while(atomic_int* field, int value) {
+    while (atomic_load(field) == value) {
+        sched_yield();
+    }
+}
+
+// Wątek agenta lidera: wchodzi do sekcji globalnej na prośbę węzła i zwalnia ją, gdy węzeł skończy serię.
+void* hier_agent(void* arg) {
+    HierLock* hier = arg;
+    NodeShared* shared = hier->shared;
+    while (true) {
+        while (!atomic_load(&shared->want_global) && atomic_load(&shared->finished) < hier->node_size) {
+            sched_yield();
         }
+        if (!atomic_load(&shared->want_global)) break; // Cały węzeł skończył pracę
+        atomic_store(&shared->want_global, 0);
+        while (!lock_try_acquire(hier->locks, 0, ACCESS_EXCLUSIVE)) {
+            lock_wait(hier->locks);
+        }
+        atomic_store(&shared->global_held, 1);
+
+        hier_wait_while(&shared->release_global, 0);
+        atomic_store(&shared->release_global, 0);
+        lock_release(hier->locks, 0, false);
+        lock_flush(hier->locks);
+    }
+    // Węzeł nie będzie już kradł - pozostali liderzy nie czekają na jego wiadomości
+    lock_announce_finish(hier->locks);
+    return NULL;
+}
+
+// Tworzy okno współdzielone węzła (operacja zbiorowa na node_comm) i u lidera uruchamia wątek agenta.
+void hier_init(HierLock* hier, MPI_Comm node_comm, int batch_limit, LockSet* locks, BenchStats* stats, Trace* trace) {
+    hier->node_comm = node_comm;
+    MPI_Comm_rank(node_comm, &hier->node_rank);
+    MPI_Comm_size(node_comm, &hier->node_size);
+    MPI_Aint size = hier->node_rank == 0 ? sizeof(NodeShared) : 0;
+    NodeShared* local;
+    MPI_Win_allocate_shared(size, 1, MPI_INFO_NULL, node_comm, &local, &hier->win);
+    MPI_Aint query_size;
+    int disp_unit;
+    MPI_Win_shared_query(hier->win, 0, &query_size, &disp_unit, &hier->shared);
+    if (hier->node_rank == 0) {
+        atomic_init(&hier->shared->next_ticket, 0);
+        atomic_init(&hier->shared->now_serving, 0);
+        atomic_init(&hier->shared->global_held, 0);
+        atomic_init(&hier->shared->want_global, 0);
+        atomic_init(&hier->shared->release_global, 0);
+        atomic_init(&hier->shared->finished, 0);
+        hier->shared->batch = 0;
+    }
+    MPI_Barrier(node_comm); // Pola zainicjalizowane przed pierwszym dostępem
+    hier->batch_limit = batch_limit > 0 ? batch_limit : 1;
+    hier->clock = 0;
+    hier->locks = locks;
+    hier->stats = stats;
+    hier->trace = trace;
+}
+
+// Uruchamia wątek agenta (u lidera) - po bench_start, bo od tej chwili tylko agent wywołuje MPI.
+void hier_start(HierLock* hier) {
+    if (hier->node_rank == 0) {
+        pthread_create(&hier->agent, NULL, hier_agent, hier);
+    }
+}
+
+int hier_acquire(HierLock* hier, int house_id) {
+    NodeShared* shared = hier->shared;
+    hier->clock++;
+    bench_request(hier->stats, 0, false);
+    trace_event(hier->trace, TRACE_CS_REQUEST, hier->clock, -1, -1, house_id);
+
+    int ticket = atomic_fetch_add(&shared->next_ticket, 1);
+    while (atomic_load(&shared->now_serving) != ticket) {
+        sched_yield();
+    }
+    if (!atomic_load(&shared->global_held)) { // Poprzednik z węzła zwolnił sekcję globalną (albo jej nie było)
+        atomic_store(&shared->want_global, 1);
+        hier_wait_while(&shared->global_held, 0);
+    }
+
+    hier->clock++;
+    bench_enter(hier->stats);
+    trace_event(hier->trace, TRACE_CS_ENTER, hier->clock, -1, -1, house_id);
+    return hier->clock;
+}
+
+void hier_release(HierLock* hier, int house_id, bool last) {
+    NodeShared* shared = hier->shared;
+    bench_exit(hier->stats);
+    hier->clock++;
+    trace_event(hier->trace, TRACE_CS_EXIT, hier->clock, -1, -1, house_id);
+
+    int serving = atomic_load(&shared->now_serving);
+    bool local_waiters = atomic_load(&shared->next_ticket) > serving + 1;
+    if (++shared->batch >= hier->batch_limit || !local_waiters) {
+        shared->batch = 0;
+        atomic_store(&shared->global_held, 0);
+        atomic_store(&shared->release_global, 1); // Lider zwolni sekcję globalną
+    }
+    atomic_store(&shared->now_serving, serving + 1); // Blokada węzła dla następnego biletu
+    if (last) {
+        atomic_fetch_add(&shared->finished, 1);
+    }
+}
+
+// Czeka na koniec wątku agenta (po ostatniej operacji procesu) - potem MPI znów wywołuje wątek główny.
+void hier_join(HierLock* hier) {
+    if (hier->node_rank == 0) {
+        pthread_join(hier->agent, NULL);
     }
-    return -1; // Zwraca -1, jeśli nie znaleziono
 }
 
-// Prosta funkcja zwracająca większą z dwóch liczb.
-int max(int a, int b) {
-    return a > b ? a : b;
+// Zwalnia okno (operacja zbiorowa na node_comm).
+void hier_free(HierLock* hier) {
+    MPI_Win_free(&hier->win);
+    MPI_Comm_free(&hier->node_comm);
 }
 
-// Funkcja pomocnicza do zwracania nazwy typu wiadomości jako string (dla logowania).
-const char* get_message_type_name(MessageType type) {
-    switch (type) {
-        case MSG_STEAL_REQ: return "żądanie KRADZIEŻY (STEAL_REQ)";
-        case MSG_STEAL_REL: return "zwolnienie KRADZIEŻY (STEAL_REL)";
-        case MSG_TERMINATE: return "ZAKOŃCZENIE PRACY (TERMINATE)";
-        default: return "NIEZNANY TYP";
+// Wybór blokady sekcji kradzieży (--lock=lamport|mcs|hier / BENCH_LOCK)
+typedef enum {
+    LOCK_LAMPORT, // Algorytm Lamporta na wiadomościach (domyślnie)
+    LOCK_MCS,     // Kolejka MCS na jednostronnej komunikacji (RMA)
+    LOCK_HIER     // Blokada węzła w pamięci współdzielonej + Lamport między liderami węzłów
+} LockKind;
+
+
+// Sekcja kradzieży za jednym interfejsem - pętla obciążenia w main nie rozróżnia blokad, więc wszystkie
+// można porównać na tym samym obciążeniu. Algorytm Lamporta to zbiór blokad z lockset.h z jednym zasobem
+// (dom 0 - jedna sekcja dla wszystkich domów); w trybie hierarchicznym używa go tylko agent lidera.
+typedef struct {
+    LockKind kind;
+    LockRuntime rt;          // Zbiór blokad, transport i wykrywanie zakończenia (u wszystkich procesów)
+    McsLock mcs;             // Blokada MCS (okno RMA tworzone tylko, gdy jest używana)
+    HierLock hier;           // Blokada hierarchiczna (okno współdzielone węzła)
+    BenchStats agent_stats;  // Liczniki agenta lidera (doliczane do procesu po zakończeniu wątku)
+    Trace agent_trace;       // Pusty ślad agenta - bufor śladu nie jest bezpieczny wątkowo
+} StealLock;
+
+// participant: uczestnicy algorytmu Lamporta. Z lease_ops > 1 kradzież zatrzymuje sekcję na kolejne operacje
+// (tylko blokada Lamporta - agent lidera rozlicza się z węzłem).
+void steal_lock_init(StealLock* lock, LockKind kind, int my_rank, int num_procs, const bool* participant,
+                     MPI_Comm node_comm, int node_batch, int lease_ops, int lease_ms, BenchStats* stats, Trace* trace) {
+    lock->kind = kind;
+    bench_init(&lock->agent_stats, 0);
+    lock->agent_stats.metrics = stats->metrics; // Agent pisze do tych samych liczników atomowych
+    bool agent = (kind == LOCK_HIER);
+    lock_runtime_init(&lock->rt, my_rank, num_procs, 1, 0, agent ? &lock->agent_stats : stats,
+                      agent ? &lock->agent_trace : trace);
+    lock_set_participants(&lock->rt.locks, participant); // Na pozostałych nie czekam (warunek 2 Lamporta)
+    if (kind == LOCK_LAMPORT) {
+        lock->rt.locks.lease_ops = lease_ops;
+        lock->rt.locks.lease_s = lease_ms / 1000.0;
+    }
+    if (kind == LOCK_MCS) {
+        mcs_init(&lock->mcs, my_rank, stats, trace);
+    }
+    if (kind == LOCK_HIER) {
+        hier_init(&lock->hier, node_comm, node_batch, &lock->rt.locks, stats, trace);
+    }
+}
+
+// Po bench_start: w trybie hierarchicznym od tej chwili MPI wywołuje tylko agent lidera.
+void steal_lock_start(StealLock* lock) {
+    if (lock->kind == LOCK_HIER) {
+        hier_start(&lock->hier);
     }
 }
 
+// Wraca po wejściu do sekcji z zegarem z chwili wejścia. MCS i blokada hierarchiczna nie mają trybu
+// współdzielonego, więc u nich oględziny są zwykłą sekcją wyłączną.
+int steal_lock_acquire(StealLock* lock, int house_id, AccessMode mode) {
+    LockSet* locks = &lock->rt.locks;
+    switch (lock->kind) {
+        case LOCK_MCS: return mcs_acquire(&lock->mcs, house_id);
+        case LOCK_HIER: return hier_acquire(&lock->hier, house_id);
+        case LOCK_LAMPORT: break;
+    }
+    locks->clock++; // Zdarzenie lokalne: początek operacji
+    while (!lock_try_acquire(locks, 0, mode)) {
+        lock_wait(locks);
+    }
+    return locks->clock;
+}
+
+// Praca w sekcji (us mikrosekund). Oglądający co READ_POLL_US obsługuje wiadomości, żeby kolejni
+// oglądający dostali potwierdzenie i weszli razem z nim.
+void steal_lock_work(StealLock* lock, int us, AccessMode mode) {
+    lock_work(&lock->rt.locks, us, lock->kind == LOCK_LAMPORT && mode == ACCESS_SHARED ? READ_POLL_US : 0);
+}
+
+// last = ostatnie wyjście procesu (informacja o końcu kradzieży doklejona do zwolnienia).
+void steal_lock_release(StealLock* lock, int house_id, bool last) {
+    switch (lock->kind) {
+        case LOCK_MCS: mcs_release(&lock->mcs, house_id, last); return;
+        case LOCK_HIER: hier_release(&lock->hier, house_id, last); return;
+        case LOCK_LAMPORT: break;
+    }
+    lock_release(&lock->rt.locks, 0, last);
+    lock_flush(&lock->rt.locks);
+}
+
+// Odpoczynek - z dzierżawą czujny (cudze żądanie odbiera ją od razu). W trybie hierarchicznym zbiór
+// blokad należy do wątku agenta, więc go nie ruszam.
+void steal_lock_idle(StealLock* lock, int us) {
+    if (lock->kind == LOCK_LAMPORT) {
+        lock_idle(&lock->rt.locks, us, READ_POLL_US);
+    } else {
+        usleep(us);
+    }
+}
+
+int steal_lock_clock(StealLock* lock) {
+    switch (lock->kind) {
+        case LOCK_MCS: return lock->mcs.clock;
+        case LOCK_HIER: return lock->hier.clock;
+        case LOCK_LAMPORT: break;
+    }
+    return lock->rt.locks.clock;
+}
+
+// Po ostatniej operacji: agent lidera kończy, gdy cały węzeł skończył, a do końca bariery zakończenia
+// proces obsługuje wiadomości innych.
+void steal_lock_finish(StealLock* lock, BenchStats* stats) {
+    if (lock->kind == LOCK_HIER) {
+        hier_join(&lock->hier);
+        stats->messages_sent += lock->agent_stats.messages_sent;
+    }
+    lock_runtime_finish(&lock->rt);
+}
+
+// Operacje zbiorowe (okno RMA, okno węzła) - wszyscy już skończyli.
+void steal_lock_free(StealLock* lock) {
+    if (lock->kind == LOCK_MCS) {
+        mcs_free(&lock->mcs);
+    }
+    if (lock->kind == LOCK_HIER) {
+        hier_free(&lock->hier);
+    }
+    lock_runtime_free(&lock->rt);
+    bench_free(&lock->agent_stats);
+}
+
 int main(int argc, char* argv[]) {
     int my_rank, num_procs; // Ranga bieżącego procesu i całkowita liczba procesów
-    MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+
+    const char* lock_name = bench_option(argc, argv, "lock", "BENCH_LOCK");
+    LockKind lock_kind = LOCK_LAMPORT;
+    if (lock_name && strcmp(lock_name, "mcs") == 0) lock_kind = LOCK_MCS;
+    if (lock_name && strcmp(lock_name, "hier") == 0) lock_kind = LOCK_HIER;
+
+    // Blokada hierarchiczna ma wątek agenta u lidera. Wątek główny nie wywołuje MPI, dopóki agent działa,
+    // więc wystarcza MPI_THREAD_SERIALIZED.
+    if (lock_kind == LOCK_HIER) {
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &provided);
+        if (provided < MPI_THREAD_SERIALIZED) {
+            // Wszystkie procesy dostają ten sam poziom, więc wszystkie wracają do algorytmu Lamporta
+            fprintf(stderr, "Brak obsługi MPI_THREAD_SERIALIZED - pracuję z blokadą Lamporta.\n");
+            lock_kind = LOCK_LAMPORT;
+        }
+    } else {
+        MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+    }
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);   // Pobranie rangi bieżącego procesu
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs); // Pobranie całkowitej liczby procesów
+    const char* program_names[] = {"na3", "na3+mcs", "na3+hier"};
+    const char* program_name = program_names[lock_kind];
 
-    int clock = 0; // Zegar Lamporta dla bieżącego procesu
-    Request steal_requests_queue[num_procs]; // Kolejka żądań dostępu do sekcji krytycznej "kradzież"
-    int steal_requests_queue_size = 0;       // Aktualny rozmiar kolejki żądań kradzieży
+    // Uczestnicy algorytmu Lamporta: wszystkie procesy albo (blokada hierarchiczna) tylko liderzy węzłów
+    bool* participant = malloc(num_procs * sizeof(bool));
+    MPI_Comm node_comm = MPI_COMM_NULL;
+    if (lock_kind == LOCK_HIER) {
+        MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, my_rank, MPI_INFO_NULL, &node_comm);
+        // --ranks-per-node=K dzieli węzeł fizyczny na węzły po K procesów (np. do testów na jednej maszynie)
+        int ranks_per_node = bench_int_option(argc, argv, "ranks-per-node", "BENCH_RANKS_PER_NODE", 0);
+        if (ranks_per_node > 0) {
+            int shared_rank;
+            MPI_Comm_rank(node_comm, &shared_rank);
+            MPI_Comm shared_comm = node_comm;
+            MPI_Comm_split(shared_comm, shared_rank / ranks_per_node, my_rank, &node_comm);
+            MPI_Comm_free(&shared_comm);
+        }
+        int node_rank;
+        MPI_Comm_rank(node_comm, &node_rank);
+        int is_leader = (node_rank == 0);
+        int* leaders = malloc(num_procs * sizeof(int));
+        MPI_Allgather(&is_leader, 1, MPI_INT, leaders, 1, MPI_INT, MPI_COMM_WORLD);
+        for (int i = 0; i < num_procs; i++) {
+            participant[i] = leaders[i];
+        }
+        free(leaders);
+    } else {
+        for (int i = 0; i < num_procs; i++) {
+            participant[i] = true;
+        }
+    }
 
-    // Tablice do śledzenia stanu komunikacji z innymi procesami dla algorytmu Lamporta
-    int highest_ts_received_steal[num_procs]; // Najwyższy timestamp odebrany od procesu i dla żądań kradzieży
-    bool is_active[num_procs];                // Flagi śledzące, które procesy są nadal aktywne
+    Workload workload; // Parametry obciążenia (linia poleceń / zmienne środowiskowe)
+    workload_init(&workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, 1);
+    BenchStats stats; // Pomiary benchmarku
+    bench_init(&stats, workload.operations);
 
-    // Inicjalizacja tablic śledzących
-    for(int i=0; i<num_procs; ++i) {
-        highest_ts_received_steal[i] = 0;
-        is_active[i] = true; // Na początku wszystkie procesy są uznawane za aktywne
-    }
+    // Ślad zdarzeń (zapisywany tylko przy --trace-dir / TRACE_DIR)
+    const char* message_names[MSG_TERMINATE + 1];
+    for (int t = 0; t <= MSG_TERMINATE; t++) message_names[t] = get_message_type_name(t);
+    Trace trace;
+    trace_init(&trace, argc, argv, program_name, my_rank, num_procs, message_names, MSG_TERMINATE + 1);
+
+    // Rejestr metryk (liczniki zawsze, migawki przy --metrics-ms / BENCH_METRICS_MS). Migawki robi tylko
+    // wątek roboczy poza trybem hierarchicznym - tam MPI (MPI_THREAD_SERIALIZED) należy w czasie pracy
+    // do agenta, więc zostaje tylko migawka końcowa.
+    static Metrics metrics;
+    metrics_init(&metrics, argc, argv, program_name, my_rank, num_procs, message_names, MSG_TERMINATE + 1,
+                 lock_kind == LOCK_MCS ? 0 : 1u << METRIC_STEAL_QUEUE);
+    stats.metrics = &metrics;
 
-    srand(my_rank * time(NULL)); // Inicjalizacja generatora liczb losowych (różne ziarno dla każdego procesu)
+    static StealLock lock; // Zbiór blokad wskazuje na pola lock - nie może się przenieść
+    steal_lock_init(&lock, lock_kind, my_rank, num_procs, participant, node_comm,
+                    bench_int_option(argc, argv, "node-batch", "BENCH_NODE_BATCH", NODE_BATCH),
+                    bench_int_option(argc, argv, "lease-ops", "BENCH_LEASE_OPS", LEASE_OPS),
+                    bench_int_option(argc, argv, "lease-ms", "BENCH_LEASE_MS", LEASE_MS), &stats, &trace);
+
+    // Inicjalizacja generatora liczb losowych (różne ziarno dla każdego procesu; stałe ziarno daje powtarzalne obciążenie)
+    srand(workload.seed >= 0 ? (unsigned)(workload.seed + my_rank) : (unsigned)(my_rank * time(NULL)));
+
+    bench_start(&stats); // Wspólny początek pomiaru
+    metrics_start(&metrics);
+    steal_lock_start(&lock);
 
     // Główna pętla symulująca operacje kradzieży
-    for (int op_count = 0; op_count < NUM_OPERATIONS; op_count++) {
+    for (int op_count = 0; op_count < workload.operations; op_count++) {
         // --- SEKCJA KRADZIEŻY ---
-        printf("--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Zwiększam zegar.\n", my_rank, clock, op_count + 1);
-
-        clock++; // Zdarzenie lokalne: inkrementacja zegara Lamporta
-        int target_house_id = (my_rank + op_count) % NUM_HOUSES_TOTAL; // Symboliczny wybór domu do okradzenia
-
-        // Przygotowanie i wysłanie żądania wejścia do sekcji krytycznej "kradzież"
-        clock++; // Zdarzenie lokalne: inkrementacja zegara Lamporta przed wysłaniem żądania
-        Request my_steal_req = {clock, my_rank}; // Utworzenie własnego żądania
-        add_to_queue(steal_requests_queue, &steal_requests_queue_size, my_steal_req); // Dodanie żądania do lokalnej kolejki
-        
-        Message msg_out_steal = {MSG_STEAL_REQ, my_steal_req.timestamp, my_rank}; // Przygotowanie wiadomości
-        for (int i = 0; i < num_procs; i++) { // Rozesłanie żądania do wszystkich innych procesów
-            if (i != my_rank) {
-                MPI_Send(&msg_out_steal, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
-        }
-        // printf("--- Proces %d --- [Zegar: %d] Wysłałem **%s** z moim czasem (ts=%d) do wszystkich innych procesów.\n", my_rank, clock, get_message_type_name(MSG_STEAL_REQ), my_steal_req.timestamp);
-
-        // Pętla oczekiwania na możliwość wejścia do sekcji krytycznej (algorytm Lamporta)
-        while (true) { 
-            int my_idx_steal = find_my_request_index(steal_requests_queue, steal_requests_queue_size, my_rank); // Znajdź moje żądanie w kolejce
-            
-            // Warunek 1 Lamporta: Moje żądanie jest na czele posortowanej kolejki
-            bool can_enter_steal_cs = (my_idx_steal == 0 && steal_requests_queue_size > 0);
-            
-            if (can_enter_steal_cs) { 
-                // Warunek 2 Lamporta: Otrzymałem wiadomość od każdego innego aktywnego procesu
-                // z timestampem późniejszym niż moje żądanie (lub tym samym timestampem i wyższą rangą).
-                // printf("--- Proces %d --- [Zegar: %d] Sprawdzam, czy moje żądanie kradzieży (ts=%d, rank=%d) jest na czele kolejki.\n", my_rank, clock, my_steal_req.timestamp, my_rank);
-                for (int i = 0; i < num_procs; i++) { 
-                    if (i == my_rank || !is_active[i]) continue; // Pomiń siebie i nieaktywne procesy
-
-                    // Sprawdzenie, czy otrzymano wiadomość od procesu 'i' z późniejszym timestampem
-                    bool received_later_message_from_i =
-                        (highest_ts_received_steal[i] > my_steal_req.timestamp) ||
-                        (highest_ts_received_steal[i] == my_steal_req.timestamp && i > my_rank); // Rozstrzyganie remisów rangą
-
-                    if (!received_later_message_from_i) {
-                        can_enter_steal_cs = false; // Jeśli nie, nie mogę jeszcze wejść do sekcji krytycznej
-                        // printf("--- Proces %d --- [Zegar: %d] Muszę czekać na odpowiedź od procesu %d lub na późniejsze żądanie. Nie mogę wejść do sekcji kradzieży.\n", my_rank, clock, i);
-                        break; // Przerwij sprawdzanie, jeden proces blokuje
-                    }
-                }
-            }
-
-            if (can_enter_steal_cs) {
-                break; // Mogę wejść do sekcji krytycznej, wyjdź z pętli oczekiwania
-            }
-
-            // Odbieranie i przetwarzanie wiadomości w pętli oczekiwania
-            int flag; // Flaga wskazująca, czy jest dostępna wiadomość
-            MPI_Status status; // Status operacji MPI_Recv
-            MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, &status); // Nieblokujące sprawdzenie, czy są wiadomości
-
-            if (flag) { // Jeśli jest wiadomość
-                Message msg_in;
-                MPI_Recv(&msg_in, sizeof(Message), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status); // Odbierz wiadomość
-                
-                // Aktualizacja zegara Lamporta na podstawie odebranej wiadomości
-                clock = max(clock, msg_in.timestamp) + 1;
-                // printf("--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d z timestampem (ts=%d). Aktualizuję zegar.\n", my_rank, clock, get_message_type_name(msg_in.type), msg_in.sender_rank, msg_in.timestamp);
-
-                // Aktualizacja najwyższego odebranego timestampu dla odpowiedniego typu wiadomości i nadawcy
-                if (msg_in.type == MSG_STEAL_REQ || msg_in.type == MSG_STEAL_REL) {
-                    highest_ts_received_steal[msg_in.sender_rank] = max(highest_ts_received_steal[msg_in.sender_rank], msg_in.timestamp);
-                }
-
-                // Przetwarzanie wiadomości w zależności od jej typu
-                if (msg_in.type == MSG_STEAL_REQ) { // Żądanie kradzieży od innego procesu
-                    Request new_req = {msg_in.timestamp, msg_in.sender_rank};
-                    add_to_queue(steal_requests_queue, &steal_requests_queue_size, new_req); // Dodaj do kolejki kradzieży
-                } else if (msg_in.type == MSG_STEAL_REL) { // Zwolnienie sekcji kradzieży przez inny proces
-                    remove_from_queue_by_rank(steal_requests_queue, &steal_requests_queue_size, msg_in.sender_rank); // Usuń z kolejki kradzieży
-                } else if (msg_in.type == MSG_TERMINATE) { // Wiadomość o zakończeniu pracy od innego procesu
-                    is_active[msg_in.sender_rank] = false; // Oznacz proces jako nieaktywny
-                }
-            } else {
-                usleep(10000); // Krótka pauza, aby nie obciążać CPU w pętli oczekiwania
-            }
-        }
+        int target_house_id = (my_rank + op_count) % workload.houses; // Symboliczny wybór domu do okradzenia
+        // Część operacji tylko ogląda dom (--read-pct)
+        AccessMode mode = workload_random_read(&workload) ? ACCESS_SHARED : ACCESS_EXCLUSIVE;
+        LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży.\n", my_rank, steal_lock_clock(&lock), op_count + 1);
+        int entry_clock = steal_lock_acquire(&lock, target_house_id, mode);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, entry_clock, target_house_id);
 
-        // Wejście do sekcji krytycznej "kradzież"
-        clock++; // Zdarzenie lokalne: inkrementacja zegara
-        printf("--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, clock, target_house_id);
-
-        usleep((rand() % 100 + 50) * 1000); // Symulacja czasu trwania kradzieży
-
-        // Wyjście z sekcji krytycznej "kradzież"
-        clock++; // Zdarzenie lokalne: inkrementacja zegara przed wysłaniem zwolnienia
-        remove_from_queue_by_rank(steal_requests_queue, &steal_requests_queue_size, my_rank); // Usuń własne żądanie z kolejki
-        
-        Message msg_steal_rel = {MSG_STEAL_REL, clock, my_rank}; // Przygotuj wiadomość o zwolnieniu
-        for (int i = 0; i < num_procs; i++) { // Rozgłoś wiadomość o zwolnieniu do wszystkich innych procesów
-            if (i != my_rank) {
-                MPI_Send(&msg_steal_rel, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
-        }
-        printf("--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Wysłałem wiadomość **%s** (ts=%d) do wszystkich innych procesów.\n", my_rank, clock, get_message_type_name(MSG_STEAL_REL), clock);
-        printf("--- Proces %d --- [Zegar: %d] Zakończyłem Operacj #%d . Odpoczywam przed kolejną próbą.\n", my_rank, clock, op_count + 1);
-        usleep((rand() % 50) * 1000); // Symulacja odpoczynku
-    }
+        steal_lock_work(&lock, workload_random_us(workload.cs_min_us, workload.cs_max_us), mode); // Kradzież albo oględziny
 
-    // Po zakończeniu wszystkich operacji, proces informuje inne procesy o swoim zakończeniu
-    Message msg_terminate = {MSG_TERMINATE, clock, my_rank}; // Przygotuj wiadomość o zakończeniu
-    for (int i = 0; i < num_procs; i++) {
-        if (i != my_rank) {
-            MPI_Send(&msg_terminate, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD); // Wyślij do innych
+        steal_lock_release(&lock, target_house_id, op_count == workload.operations - 1);
+        LOG(1, "--- Proces %d --- Zakończyłem Operacj #%d . Odpoczywam przed kolejną próbą.\n", my_rank, op_count + 1);
+        trace_flush(&trace); // Zrzut śladu poza sekcją krytyczną i pętlą oczekiwania
+        if (lock_kind != LOCK_HIER) {
+            metrics_tick(&metrics, steal_lock_clock(&lock));
         }
+        steal_lock_idle(&lock, workload_random_us(workload.think_min_us, workload.think_max_us));
     }
-    // printf("--- Proces %d --- [Zegar: %d] Wysłałem wiadomość **%s** do wszystkich innych procesów przed zakończeniem.\n", my_rank, clock, get_message_type_name(MSG_TERMINATE));
+    bench_finish(&stats); // Koniec pomiaru
+    int final_clock = steal_lock_clock(&lock);
+    trace_event(&trace, TRACE_FINISH, final_clock, -1, -1, -1);
+    steal_lock_finish(&lock, &stats);
 
-    printf("--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Finalizuję pracę.\n", my_rank, clock);
-    MPI_Barrier(MPI_COMM_WORLD); // Bariera, aby upewnić się, że wszystkie procesy doszły do tego punktu przed finalizacją
-                                 // Pomaga to zapewnić, że wszystkie wiadomości TERMINATE zostaną wysłane i potencjalnie odebrane.
+    LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Finalizuję pracę.\n", my_rank, final_clock);
+    metrics_finish(&metrics, final_clock); // Migawka końcowa (operacja zbiorowa)
+    bench_report(&stats, &workload, program_name, my_rank, num_procs); // Raport benchmarku (proces 0)
+    bench_free(&stats);
+    metrics_free(&metrics);
+    trace_close(&trace); // Zrzut reszty śladu przed MPI_Finalize
+    steal_lock_free(&lock);
+    free(participant);
     MPI_Finalize(); // Zakończenie pracy środowiska MPI
     return 0;
 }
@@ -5,172 +5,200 @@
 #include <unistd.h>      // Dla funkcji usleep (pauza)
 #include <time.h>        // Dla funkcji time() (inicjalizacja generatora liczb losowych)
 #include <stdbool.h>     // Dla typów bool, true, false
+#include <pthread.h>     // Dla wątku postępu (tryb --progress-thread)
+#include "bench.h"       // Parametry obciążenia i pomiary benchmarku
+#include "trace.h"       // Binarny ślad zdarzeń i poziomy logowania (LOG_LEVEL)
+#include "lockset.h"     // Ricart-Agrawala (zbiór blokad w trybie zgód), transport MPI i wykrywanie zakończenia
+
+#define NUM_HOUSES_TOTAL 2 // Całkowita liczba domów (domyślnie; --houses / BENCH_HOUSES)
+#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść (domyślnie; --ops / BENCH_OPS)
+
+// Algorytm Ricarta-Agrawali z optymalizacją Roucairola-Carvalho: zbiór blokad z lockset.h w trybie zgód
+// (lock_set_use_ra) z jednym zasobem - dom 0, jedna sekcja dla wszystkich domów.
+// W trybie z wątkiem postępu zbiór należy do wątku komunikacyjnego: wątek roboczy (operacje kradzieży)
+// dotyka go wyłącznie przez ra_acquire/ra_release, a każdy dostęp odbywa się pod blokadą lock.
+typedef struct {
+    LockRuntime rt;                 // Zbiór blokad, transport i wykrywanie zakończenia
+    bool progress_thread;           // Czy wiadomości obsługuje osobny wątek komunikacyjny
+    pthread_mutex_t lock;           // Chroni zbiór blokad (oraz statystyki i ślad) w trybie z wątkiem
+    pthread_cond_t permission_cond; // Sygnalizowany po obsłużeniu wiadomości (mogła przyjść zgoda)
+    pthread_t progress;
+} RALock;
+
+void ra_init(RALock* ra, int my_rank, int num_procs, bool progress_thread, BenchStats* stats, Trace* trace) {
+    lock_runtime_init(&ra->rt, my_rank, num_procs, 1, 0, stats, trace);
+    lock_set_use_ra(&ra->rt.locks);
+    ra->rt.locks.external_progress = progress_thread;
+    ra->progress_thread = progress_thread;
+    pthread_mutex_init(&ra->lock, NULL);
+    pthread_cond_init(&ra->permission_cond, NULL);
+}
 
-#define NUM_HOUSES_TOTAL 2 // Całkowita liczba domów
-#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść
+// Wątek komunikacyjny: odbiera i przetwarza wiadomości bez przerwy - także wtedy, gdy wątek roboczy
+// jest w sekcji krytycznej albo odpoczywa - aż wątek roboczy po barierze zakończenia przyśle mu TERMINATE.
+void* ra_progress_thread(void* arg) {
+    RALock* ra = arg;
+    LockSet* locks = &ra->rt.locks;
+    while (true) {
+        // Odbiór poza blokadą - wątek roboczy może w tym czasie wysyłać
+        Message msg_in;
+        locks->transport.recv(locks->transport.ctx, &msg_in);
+        if (msg_in.type == MSG_TERMINATE && msg_in.sender_rank == locks->my_rank) break;
+
+        pthread_mutex_lock(&ra->lock);
+        lock_dispatch(locks, &msg_in);
+        lock_flush(locks);
+        pthread_cond_signal(&ra->permission_cond);
+        pthread_mutex_unlock(&ra->lock);
+    }
+    return NULL;
+}
 
-// Typy wiadomości używane w komunikacji MPI
-typedef enum {
-    MSG_REQ,         // Żądanie dostępu do sekcji krytycznej (Request)
-    MSG_ACK,         // Potwierdzenie / Zgoda (Acknowledgement)
-    MSG_TERMINATE    // Wiadomość informująca o zakończeniu pracy przez proces
-} MessageType;
+void ra_start(RALock* ra) {
+    if (ra->progress_thread) {
+        pthread_create(&ra->progress, NULL, ra_progress_thread, ra);
+    }
+}
 
-// Struktura wiadomości przesyłanej między procesami
-typedef struct {
-    MessageType type;      // Typ wiadomości (z enum MessageType)
-    int timestamp;         // Zegar Lamporta nadawcy wiadomości
-    int sender_rank;       // Ranga (ID) procesu wysyłającego wiadomość
-} Message;
-
-// Prosta funkcja zwracająca większą z dwóch liczb.
-int max(int a, int b) {
-    return a > b ? a : b;
+// Odczyt zegara (wątek komunikacyjny może go zmieniać w każdej chwili).
+int ra_clock(RALock* ra) {
+    pthread_mutex_lock(&ra->lock);
+    int clock = ra->rt.locks.clock;
+    pthread_mutex_unlock(&ra->lock);
+    return clock;
+}
+
+// Ubieganie się o sekcję krytyczną; wraca po wejściu do niej z zegarem z chwili wejścia.
+int ra_acquire(RALock* ra) {
+    LockSet* locks = &ra->rt.locks;
+    pthread_mutex_lock(&ra->lock);
+    while (!lock_try_acquire(locks, 0, ACCESS_EXCLUSIVE)) { // Czekam na zgody wszystkich procesów
+        if (ra->progress_thread) {
+            pthread_cond_wait(&ra->permission_cond, &ra->lock); // Wiadomości obsługuje wątek komunikacyjny
+        } else {
+            lock_wait(locks);
+        }
+    }
+    int entry_clock = locks->clock;
+    pthread_mutex_unlock(&ra->lock);
+    return entry_clock;
+}
+
+// Wyjście z sekcji krytycznej: wysyłam opóźnione ACK.
+void ra_release(RALock* ra) {
+    pthread_mutex_lock(&ra->lock);
+    lock_release(&ra->rt.locks, 0, false);
+    LOG(1, "--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Wysyłam opóźnione ACK.\n", ra->rt.locks.my_rank, ra->rt.locks.clock);
+    lock_flush(&ra->rt.locks);
+    pthread_mutex_unlock(&ra->lock);
 }
 
-// Funkcja pomocnicza do zwracania nazwy typu wiadomości jako string (dla logowania).
-const char* get_message_type_name(MessageType type) {
-    switch (type) {
-        case MSG_REQ: return "ŻĄDANIE (REQ)";
-        case MSG_ACK: return "POTWIERDZENIE (ACK)";
-        case MSG_TERMINATE: return "ZAKOŃCZENIE PRACY (TERMINATE)";
-        default: return "NIEZNANY TYP";
+// Wykrywanie zakończenia: do czasu, aż wszyscy skończą (bariera nieblokująca), nadal odpowiadam na REQ -
+// inni mogą potrzebować mojej zgody. Zakończony proces nie udaje już zgody przez TERMINATE.
+void ra_finish(RALock* ra) {
+    LockSet* locks = &ra->rt.locks;
+    if (ra->progress_thread) {
+        lock_runtime_stop(&ra->rt);
+        MPI_Wait(&ra->rt.termination.barrier, MPI_STATUS_IGNORE); // Na REQ odpowiada wątek postępu
+        pthread_mutex_lock(&ra->lock); // Liczniki wysłanych i ślad zmienia też wątek postępu
+        locks->stats = NULL;
+        Message msg_stop = {.type = MSG_TERMINATE, .timestamp = 0, .sender_rank = locks->my_rank, .house_id = -1};
+        lock_send(locks, &msg_stop, locks->my_rank); // Budzi wątek postępu i kończy go
+        lock_flush(locks);
+        pthread_mutex_unlock(&ra->lock);
+        pthread_join(ra->progress, NULL);
     }
+    lock_runtime_finish(&ra->rt);
+}
+
+void ra_free(RALock* ra) {
+    lock_runtime_free(&ra->rt);
+    pthread_cond_destroy(&ra->permission_cond);
+    pthread_mutex_destroy(&ra->lock);
 }
 
 int main(int argc, char* argv[]) {
     int my_rank, num_procs; // Ranga bieżącego procesu i całkowita liczba procesów
-    MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+
+    // Tryb z wątkiem postępu (--progress-thread=1 / BENCH_PROGRESS_THREAD=1) wymaga MPI_THREAD_MULTIPLE:
+    // wątek komunikacyjny i wątek roboczy wysyłają wiadomości niezależnie.
+    bool progress_thread = bench_int_option(argc, argv, "progress-thread", "BENCH_PROGRESS_THREAD", 0) != 0;
+    if (progress_thread) {
+        int provided;
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+        if (provided < MPI_THREAD_MULTIPLE) {
+            // Wszystkie procesy dostają ten sam poziom, więc wszystkie wracają do trybu bez wątku
+            fprintf(stderr, "Brak obsługi MPI_THREAD_MULTIPLE - pracuję bez wątku postępu.\n");
+            progress_thread = false;
+        }
+    } else {
+        MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+    }
     MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);    // Pobranie rangi bieżącego procesu
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);  // Pobranie całkowitej liczby procesów
 
-    int clock = 0; // Zegar Lamporta dla bieżącego procesu
-    
-    // Statusy procesu Ricarta-Agrawali
-    bool requesting_cs = false; // Czy proces aktualnie ubiega się o sekcję krytyczną
-    int my_request_timestamp = -1; // Timestamp mojego bieżącego żądania
-    int replies_received_count = 0; // Licznik otrzymanych ACK
-
-    // Kolejka żądań do opóźnionych ACK (dla procesów, które muszą czekać na moje zwolnienie)
-    int deferred_reply_queue[num_procs];
-    int deferred_reply_queue_size = 0;
-
-    // Tablice do śledzenia stanu aktywności innych procesów (dla terminacji)
-    bool is_active[num_procs];
-    for(int i=0; i<num_procs; ++i) {
-        is_active[i] = true;
-    }
+    Workload workload; // Parametry obciążenia (linia poleceń / zmienne środowiskowe)
+    workload_init(&workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, 1);
+    BenchStats stats; // Pomiary benchmarku
+    bench_init(&stats, workload.operations);
+    const char* program_name = progress_thread ? "nowa+progress" : "nowa";
 
-    srand(my_rank * time(NULL)); // Inicjalizacja generatora liczb losowych
+    // Ślad zdarzeń (zapisywany tylko przy --trace-dir / TRACE_DIR)
+    const char* message_names[MSG_TERMINATE + 1];
+    for (int t = 0; t <= MSG_TERMINATE; t++) message_names[t] = get_message_type_name(t);
+    Trace trace;
+    trace_init(&trace, argc, argv, program_name, my_rank, num_procs, message_names, MSG_TERMINATE + 1);
+    static Metrics metrics; // Rejestr metryk (liczniki zawsze, migawki przy --metrics-ms / BENCH_METRICS_MS)
+    metrics_init(&metrics, argc, argv, program_name, my_rank, num_procs, message_names, MSG_TERMINATE + 1,
+                 1u << METRIC_DEFERRED);
+    stats.metrics = &metrics;
 
-    // Główna pętla symulująca operacje kradzieży
-    for (int op_count = 0; op_count < NUM_OPERATIONS; op_count++) {
-        // --- PRÓBA WEJŚCIA DO SEKCJI KRYTYCZNEJ ---
-        printf("--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Zwiększam zegar.\n", my_rank, clock, op_count + 1);
-        
-        clock++; // Zdarzenie lokalne: inkrementacja zegara Lamporta
-        requesting_cs = true; // Ustawiam flagę, że ubiegam się o SC
-        my_request_timestamp = clock; // Zapamiętuję timestamp mojego żądania
-        replies_received_count = 0; // Resetuję licznik ACK
-
-        Message msg_out_req = {MSG_REQ, my_request_timestamp, my_rank}; // Przygotowanie wiadomości REQ
-        // printf("--- Proces %d --- [Zegar: %d] Wysyłam **%s** (ts=%d) do wszystkich.\n", my_rank, clock, get_message_type_name(MSG_REQ), my_request_timestamp);
-        for (int i = 0; i < num_procs; i++) { // Rozesłanie żądania do wszystkich innych procesów
-            if (i != my_rank) {
-                MPI_Send(&msg_out_req, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-            }
-        }
+    static RALock ra; // Zbiór blokad wskazuje na pola ra - nie może się przenieść
+    ra_init(&ra, my_rank, num_procs, progress_thread, &stats, &trace);
 
-        // Pętla oczekiwania na możliwość wejścia do sekcji krytycznej (Ricart-Agrawala)
-        while (replies_received_count < (num_procs - 1)) { // Czekaj na ACK od wszystkich N-1 procesów
-            int flag; // Flaga wskazująca, czy jest dostępna wiadomość
-            MPI_Status status; // Status operacji MPI_Recv
-            
-            // Sprawdzenie, czy są wiadomości (nieblokujące)
-            MPI_Iprobe(MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &flag, &status);
-
-            if (flag) { // Jeśli jest wiadomość
-                Message msg_in;
-                MPI_Recv(&msg_in, sizeof(Message), MPI_BYTE, MPI_ANY_SOURCE, 0, MPI_COMM_WORLD, &status); // Odbierz wiadomość
-                
-                // Aktualizacja zegara Lamporta na podstawie odebranej wiadomości
-                clock = max(clock, msg_in.timestamp) + 1;
-                // printf("--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d (ts=%d).\n", my_rank, clock, get_message_type_name(msg_in.type), msg_in.sender_rank, msg_in.timestamp);
-
-                // Przetwarzanie wiadomości w zależności od jej typu
-                if (msg_in.type == MSG_REQ) { // Żądanie dostępu od innego procesu
-                    bool defer_reply = false; // Czy opóźnić odpowiedź?
-
-                    // Jeśli ja się ubiegam ORAZ moje żądanie ma wyższy priorytet (niższy timestamp)
-                    // LUB jeśli moje żądanie ma ten sam timestamp, ale moją rangę jest niższa (reguła rozstrzygania remisu)
-                    if (requesting_cs && 
-                        ((my_request_timestamp < msg_in.timestamp) || 
-                         (my_request_timestamp == msg_in.timestamp && my_rank < msg_in.sender_rank))) {
-                        defer_reply = true; // Opóźnij odpowiedź, bo mam wyższy priorytet
-                    }
-
-                    if (defer_reply) {
-                        // Dodaj nadawcę do kolejki oczekujących na ACK
-                        deferred_reply_queue[deferred_reply_queue_size++] = msg_in.sender_rank;
-                        // printf("--- Proces %d --- [Zegar: %d] Opóźniam ACK dla procesu %d. Moje żądanie (ts=%d) ma wyższy priorytet.\n", my_rank, clock, msg_in.sender_rank, my_request_timestamp);
-                    } else {
-                        // Wysyłam ACK od razu
-                        clock++; // Zdarzenie lokalne: wysłanie ACK
-                        Message msg_out_ack = {MSG_ACK, clock, my_rank};
-                        MPI_Send(&msg_out_ack, sizeof(Message), MPI_BYTE, msg_in.sender_rank, 0, MPI_COMM_WORLD);
-                        // printf("--- Proces %d --- [Zegar: %d] Wysłałem **%s** do procesu %d.\n", my_rank, clock, get_message_type_name(MSG_ACK), msg_in.sender_rank);
-                    }
-                } else if (msg_in.type == MSG_ACK) { // Otrzymanie ACK od innego procesu
-                    replies_received_count++; // Zwiększ licznik otrzymanych ACK
-                    // printf("--- Proces %d --- [Zegar: %d] Otrzymałem ACK od procesu %d. Liczba ACK: %d/%d\n", my_rank, clock, msg_in.sender_rank, replies_received_count, num_procs - 1);
-                } else if (msg_in.type == MSG_TERMINATE) { // Wiadomość o zakończeniu pracy od innego procesu
-                    is_active[msg_in.sender_rank] = false; // Oznacz proces jako nieaktywny
-                    // Jeśli proces zakończył pracę, a ja go brałem pod uwagę do ACK, to mogę to uznać za otrzymane ACK
-                    // Jest to uproszczenie, aby symulacja nie zawieszała się na oczekiwaniu na nieaktywne procesy.
-                    // W bardziej robustnym systemie należałoby to rozwiązać inaczej (np. algorytm kworum).
-                    replies_received_count++; 
-                    printf("--- Proces %d --- [Zegar: %d] Proces %d zakończył pracę. Uznaję to jako otrzymane ACK.\n", my_rank, clock, msg_in.sender_rank);
-                }
-            } else {
-                usleep(10000); // Krótka pauza, aby nie obciążać CPU w pętli oczekiwania
-            }
-        }
+    // Inicjalizacja generatora liczb losowych (stałe ziarno daje powtarzalne obciążenie)
+    srand(workload.seed >= 0 ? (unsigned)(workload.seed + my_rank) : (unsigned)(my_rank * time(NULL)));
 
-        // --- WEJŚCIE DO SEKCJI KRYTYCZNEJ ---
-        clock++; // Zdarzenie lokalne: inkrementacja zegara
-        int target_house_id = (my_rank + op_count) % NUM_HOUSES_TOTAL; // Symboliczny wybór domu do okradzenia
-        printf("--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, clock, target_house_id);
+    bench_start(&stats); // Wspólny początek pomiaru
+    metrics_start(&metrics);
+    ra_start(&ra);
 
-        usleep((rand() % 100 + 50) * 1000); // Symulacja czasu trwania kradzieży
+    // Główna pętla symulująca operacje kradzieży
+    for (int op_count = 0; op_count < workload.operations; op_count++) {
+        // --- PRÓBA WEJŚCIA DO SEKCJI KRYTYCZNEJ ---
+        LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży.\n", my_rank, ra_clock(&ra), op_count + 1);
+        int entry_clock = ra_acquire(&ra);
 
-        // --- WYJŚCIE Z SEKCJI KRYTYCZNEJ ---
-        clock++; // Zdarzenie lokalne: inkrementacja zegara
-        requesting_cs = false; // Nie ubiegam się już o SC
-
-        printf("--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Wysyłam opóźnione ACK.\n", my_rank, clock);
-        // Wysyłanie opóźnionych ACK
-        for (int i = 0; i < deferred_reply_queue_size; i++) {
-            int target_rank = deferred_reply_queue[i];
-            Message msg_out_ack = {MSG_ACK, clock, my_rank}; // ACK z aktualnym timestampem
-            MPI_Send(&msg_out_ack, sizeof(Message), MPI_BYTE, target_rank, 0, MPI_COMM_WORLD);
-            // printf("--- Proces %d --- [Zegar: %d] Wysłałem opóźnione **%s** do procesu %d.\n", my_rank, clock, get_message_type_name(MSG_ACK), target_rank);
-        }
-        deferred_reply_queue_size = 0; // Wyczyść kolejkę opóźnionych odpowiedzi
+        int target_house_id = (my_rank + op_count) % workload.houses; // Symboliczny wybór domu do okradzenia
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, entry_clock, target_house_id);
 
-        printf("--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d. Odpoczywam przed kolejną próbą.\n", my_rank, clock, op_count + 1);
-        usleep((rand() % 50) * 1000); // Symulacja odpoczynku
-    }
+        usleep(workload_random_us(workload.cs_min_us, workload.cs_max_us)); // Symulacja czasu trwania kradzieży
 
-    // Po zakończeniu wszystkich operacji, proces informuje inne procesy o swoim zakończeniu
-    Message msg_terminate = {MSG_TERMINATE, clock, my_rank}; // Przygotuj wiadomość o zakończeniu
-    for (int i = 0; i < num_procs; i++) {
-        if (i != my_rank) {
-            MPI_Send(&msg_terminate, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD); // Wyślij do innych
-        }
+        // --- WYJŚCIE Z SEKCJI KRYTYCZNEJ ---
+        ra_release(&ra);
+
+        pthread_mutex_lock(&ra.lock);
+        LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d. Odpoczywam przed kolejną próbą.\n", my_rank, ra.rt.locks.clock, op_count + 1);
+        trace_flush(&trace); // Zrzut śladu poza sekcją krytyczną i pętlą oczekiwania
+        pthread_mutex_unlock(&ra.lock);
+        metrics_tick(&metrics, ra_clock(&ra)); // Migawki za minione okresy (poza blokadą - wątek postępu może działać)
+        usleep(workload_random_us(workload.think_min_us, workload.think_max_us)); // Symulacja odpoczynku
     }
-    printf("--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Finalizuję pracę.\n", my_rank, clock);
-
-    MPI_Barrier(MPI_COMM_WORLD); // Bariera, aby upewnić się, że wszystkie procesy doszły do tego punktu przed finalizacją
+    bench_finish(&stats); // Koniec pomiaru
+
+    pthread_mutex_lock(&ra.lock);
+    int final_clock = ra.rt.locks.clock;
+    trace_event(&trace, TRACE_FINISH, final_clock, -1, -1, -1);
+    LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Finalizuję pracę.\n", my_rank, final_clock);
+    pthread_mutex_unlock(&ra.lock);
+    ra_finish(&ra);
+
+    metrics_finish(&metrics, ra.rt.locks.clock); // Migawka końcowa (operacja zbiorowa)
+    bench_report(&stats, &workload, program_name, my_rank, num_procs); // Raport benchmarku (proces 0)
+    bench_free(&stats);
+    metrics_free(&metrics);
+    trace_close(&trace); // Zrzut reszty śladu przed MPI_Finalize
+    ra_free(&ra);
     MPI_Finalize(); // Zakończenie pracy środowiska MPI
     return 0;
-}
\ No newline at end of file
+}
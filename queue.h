@@ -0,0 +1,174 @@
+// Kolejka żądań sekcji krytycznej (wspólna dla lockset.h - czyli mpi.c, na3.c, nowa.c i symulatora sim.c).
+// Kopiec binarny (wg timestampu, potem wg rangi) z indeksem ranga -> pozycja w kopcu: każdy proces ma
+// w kolejce co najwyżej jedno żądanie, więc dodanie i usunięcie kosztują O(log N).
+// Kolejka pamięta też, ile żądań poprzedza żądanie właściciela (owner_rank) i ile z nich to kradzieże,
+// więc pytania "czy jestem na czele / czy przede mną są sami oglądający" kosztują O(1).
+// Bez MPI - moduł nie wysyła ani nie odbiera wiadomości.
+#ifndef QUEUE_H
+#define QUEUE_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Tryb dostępu do sekcji
+typedef enum {
+    ACCESS_EXCLUSIVE, // Kradzież - w sekcji sam
+    ACCESS_SHARED     // Oględziny domu - razem z innymi oglądającymi, ale nie z kradnącym
+} AccessMode;
+
+// Żądanie w kolejce
+typedef struct {
+    int timestamp;
+    int rank;
+    AccessMode mode; // Nie wpływa na kolejność
+} Request;
+
+typedef struct {
+    Request* heap;       // Kopiec binarny żądań
+    int* slot_of_rank;   // Pozycja żądania procesu w kopcu (-1, jeśli proces nie ma żądania)
+    int size;            // Aktualna liczba żądań w kolejce
+    int owner_rank;      // Ranga procesu, który jest właścicielem tej kopii kolejki
+    int ahead_of_owner;  // Liczba żądań przed żądaniem właściciela (-1, jeśli go nie ma)
+    int exclusive_ahead_of_owner; // Ile z nich to żądania wyłączne (kradzieże)
+} RequestQueue;
+
+static inline int max(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Porządek żądań: najpierw wg timestampu, a w przypadku remisów wg rangi procesu.
+static inline int compare_requests(const void* a, const void* b) {
+    const Request* r_a = a;
+    const Request* r_b = b;
+    if (r_a->timestamp != r_b->timestamp) {
+        return r_a->timestamp - r_b->timestamp;
+    }
+    return r_a->rank - r_b->rank;
+}
+
+// Zwraca true, jeśli żądanie a ma wyższy priorytet niż b.
+static inline bool request_before(Request a, Request b) {
+    return compare_requests(&a, &b) < 0;
+}
+
+// Czy wiadomość (ts, sender_rank) jest późniejsza niż żądanie req (remisy timestampów rozstrzyga ranga).
+static inline bool is_later_message(int ts, int sender_rank, Request req) {
+    return ts > req.timestamp || (ts == req.timestamp && sender_rank > req.rank);
+}
+
+// Inicjalizuje pustą kolejkę dla num_procs procesów.
+static void init_queue(RequestQueue* queue, int num_procs, int owner_rank) {
+    queue->heap = malloc((num_procs > 0 ? num_procs : 1) * sizeof(Request));
+    queue->slot_of_rank = malloc((num_procs > 0 ? num_procs : 1) * sizeof(int));
+    for (int i = 0; i < num_procs; i++) {
+        queue->slot_of_rank[i] = -1;
+    }
+    queue->size = 0;
+    queue->owner_rank = owner_rank;
+    queue->ahead_of_owner = -1;
+    queue->exclusive_ahead_of_owner = 0;
+}
+
+static void free_queue(RequestQueue* queue) {
+    free(queue->heap);
+    free(queue->slot_of_rank);
+}
+
+// Umieszcza żądanie na pozycji i w kopcu i aktualizuje indeks rang.
+static inline void place_in_heap(RequestQueue* queue, int i, Request req) {
+    queue->heap[i] = req;
+    queue->slot_of_rank[req.rank] = i;
+}
+
+// Przesuwa żądanie z pozycji i w górę kopca, dopóki ma wyższy priorytet niż rodzic.
+static void sift_up(RequestQueue* queue, int i) {
+    Request req = queue->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!request_before(req, queue->heap[parent])) break;
+        place_in_heap(queue, i, queue->heap[parent]);
+        i = parent;
+    }
+    place_in_heap(queue, i, req);
+}
+
+// Przesuwa żądanie z pozycji i w dół kopca, dopóki któreś z dzieci ma wyższy priorytet.
+static void sift_down(RequestQueue* queue, int i) {
+    Request req = queue->heap[i];
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= queue->size) break;
+        if (child + 1 < queue->size && request_before(queue->heap[child + 1], queue->heap[child])) {
+            child++; // Dziecko o wyższym priorytecie
+        }
+        if (!request_before(queue->heap[child], req)) break;
+        place_in_heap(queue, i, queue->heap[child]);
+        i = child;
+    }
+    place_in_heap(queue, i, req);
+}
+
+// Liczy żądania o wyższym priorytecie niż req w poddrzewie o korzeniu i (exclusive_only: tylko kradzieże).
+// Schodzi tylko do węzłów poprzedzających req, więc koszt jest proporcjonalny do ich liczby.
+static int count_requests_before(RequestQueue* queue, int i, Request req, bool exclusive_only) {
+    if (i >= queue->size || !request_before(queue->heap[i], req)) {
+        return 0;
+    }
+    int self = !exclusive_only || queue->heap[i].mode == ACCESS_EXCLUSIVE;
+    return self + count_requests_before(queue, 2 * i + 1, req, exclusive_only) +
+           count_requests_before(queue, 2 * i + 2, req, exclusive_only);
+}
+
+// Usuwa żądanie procesu z kolejki w O(log N).
+static void remove_from_queue_by_rank(RequestQueue* queue, int rank_to_remove) {
+    int i = queue->slot_of_rank[rank_to_remove];
+    if (i == -1) return; // Proces nie ma żądania w kolejce
+
+    Request removed = queue->heap[i];
+    if (rank_to_remove == queue->owner_rank) {
+        queue->ahead_of_owner = -1;
+    } else if (queue->ahead_of_owner != -1 &&
+               request_before(removed, queue->heap[queue->slot_of_rank[queue->owner_rank]])) {
+        queue->ahead_of_owner--; // Usunięto żądanie, które było przed moim
+        if (removed.mode == ACCESS_EXCLUSIVE) queue->exclusive_ahead_of_owner--;
+    }
+
+    queue->slot_of_rank[rank_to_remove] = -1;
+    queue->size--;
+    if (i == queue->size) return; // Usunięto ostatni element kopca
+
+    Request last = queue->heap[queue->size]; // Ostatni element wstawiamy w miejsce usuniętego
+    place_in_heap(queue, i, last);
+    if (request_before(last, removed)) {
+        sift_up(queue, i);
+    } else {
+        sift_down(queue, i);
+    }
+}
+
+// Dodaje żądanie do kolejki w O(log N) (poprzednie żądanie tego procesu znika).
+static void add_to_queue(RequestQueue* queue, Request req) {
+    remove_from_queue_by_rank(queue, req.rank);
+
+    if (req.rank == queue->owner_rank) {
+        queue->ahead_of_owner = count_requests_before(queue, 0, req, false);
+        queue->exclusive_ahead_of_owner = count_requests_before(queue, 0, req, true);
+    } else if (queue->ahead_of_owner != -1 &&
+               request_before(req, queue->heap[queue->slot_of_rank[queue->owner_rank]])) {
+        queue->ahead_of_owner++; // Nowe żądanie wyprzedza moje
+        if (req.mode == ACCESS_EXCLUSIVE) queue->exclusive_ahead_of_owner++;
+    }
+
+    place_in_heap(queue, queue->size, req);
+    queue->size++;
+    sift_up(queue, queue->size - 1);
+}
+
+// Warunek 1 Lamporta w wersji czytelnicy-pisarze: kradzież musi być na czele kolejki, a oględziny mogą
+// wejść, gdy przed nimi są sami oglądający - kolejni oglądający z czoła kolejki wchodzą więc razem.
+static inline bool my_request_may_enter(const RequestQueue* queue, AccessMode mode) {
+    if (queue->ahead_of_owner == -1) return false;
+    return mode == ACCESS_SHARED ? queue->exclusive_ahead_of_owner == 0 : queue->ahead_of_owner == 0;
+}
+
+#endif
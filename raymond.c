@@ -0,0 +1,324 @@
+#include <mpi.h>         // MPI biblioteka do komunikacji międzyprocesowej
+#include <stdio.h>       // Standardowe wejście/wyjście (np. printf)
+#include <stdlib.h>      // Standardowe funkcje biblioteczne (np. rand, malloc)
+#include <string.h>      // Funkcje do operacji na stringach (nieużywane bezpośrednio, ale często przydatne)
+#include <unistd.h>      // Dla funkcji usleep (pauza)
+#include <time.h>        // Dla funkcji time() (inicjalizacja generatora liczb losowych)
+#include <stdbool.h>     // Dla typów bool, true, false
+#include "bench.h"       // Parametry obciążenia i pomiary benchmarku
+#include "trace.h"       // Binarny ślad zdarzeń i poziomy logowania (LOG_LEVEL)
+#include "metrics.h"     // Rejestr metryk protokołu (migawki --metrics-ms)
+#include "transport.h"   // Odbiór wiadomości na stałych żądaniach MPI (RecvEngine)
+
+#define NUM_HOUSES_TOTAL 2 // Całkowita liczba domów (domyślnie; --houses / BENCH_HOUSES)
+#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść (domyślnie; --ops / BENCH_OPS)
+
+#ifndef TREE_ARITY
+#define TREE_ARITY 2       // Liczba dzieci każdego węzła drzewa rozpinającego (2 = drzewo binarne, k = drzewo k-arne)
+#endif
+#ifndef TREE_REORDER
+#define TREE_REORDER 0     // 1 = pozwól MPI_Dist_graph_create_adjacent przenumerować procesy zgodnie z topologią sieci
+#endif
+
+#define SELF -1            // Oznaczenie "ja sam" w polu holder i w kolejce żądań
+
+// Typy wiadomości używane w komunikacji MPI (algorytm Raymonda)
+typedef enum {
+    MSG_REQ,         // Żądanie tokenu przekazywane w stronę jego posiadacza
+    MSG_PRIVILEGE,   // Przekazanie tokenu (przywileju) sąsiadowi
+    MSG_DONE,        // Całe poddrzewo nadawcy zakończyło pracę (zbierane w stronę korzenia)
+    MSG_SHUTDOWN     // Wszystkie procesy zakończyły pracę (rozsyłane od korzenia w dół drzewa)
+} MessageType;
+
+// Struktura wiadomości przesyłanej między procesami
+typedef struct {
+    MessageType type;      // Typ wiadomości (z enum MessageType)
+    int timestamp;         // Zegar Lamporta nadawcy wiadomości
+    int sender_rank;       // Ranga (ID) procesu wysyłającego wiadomość w komunikatorze drzewa
+} Message;
+
+// Stan węzła w algorytmie Raymonda. Węzeł zna tylko swoich sąsiadów w drzewie,
+// a nie stan wszystkich N procesów.
+typedef struct {
+    MPI_Comm comm;         // Komunikator z topologią drzewa (MPI_Dist_graph_create_adjacent)
+    int my_rank;           // Ranga w komunikatorze drzewa
+    int clock;             // Zegar Lamporta
+
+    int* neighbors;        // Sąsiedzi w drzewie: najpierw rodzic (jeśli jest), potem dzieci
+    int degree;            // Liczba sąsiadów
+    int parent;            // Ranga rodzica lub SELF dla korzenia
+    int num_children;      // Liczba dzieci
+
+    int holder;            // Sąsiad w kierunku tokenu lub SELF, jeśli token jest u mnie
+    bool using;            // Czy jestem w sekcji krytycznej
+    bool asked;            // Czy wysłałem już żądanie do holdera
+    int* request_q;        // Kolejka FIFO żądań (sąsiedzi lub SELF), co najwyżej degree + 1 elementów
+    int q_head;
+    int q_size;
+
+    int done_children;     // Liczba dzieci, których poddrzewa zakończyły pracę
+    bool shutdown;         // Czy otrzymałem sygnał końca pracy
+    BenchStats* stats;     // Pomiary benchmarku (NULL po zakończeniu pomiaru)
+    Trace* trace;          // Ślad zdarzeń (rangi partnerów w komunikatorze drzewa)
+} RaymondNode;
+
+// Prosta funkcja zwracająca większą z dwóch liczb.
+int max(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Funkcja pomocnicza do zwracania nazwy typu wiadomości jako string (dla logowania).
+const char* get_message_type_name(MessageType type) {
+    switch (type) {
+        case MSG_REQ: return "ŻĄDANIE TOKENU (REQ)";
+        case MSG_PRIVILEGE: return "TOKEN (PRIVILEGE)";
+        case MSG_DONE: return "PODDRZEWO ZAKOŃCZYŁO (DONE)";
+        case MSG_SHUTDOWN: return "ZAKOŃCZENIE PRACY (SHUTDOWN)";
+        default: return "NIEZNANY TYP";
+    }
+}
+
+// Buduje drzewo TREE_ARITY-arne (numeracja jak w kopcu: rodzic węzła i to (i-1)/TREE_ARITY)
+// jako komunikator z topologią grafu rozproszonego. Przy TREE_REORDER = 1 MPI może przenumerować
+// procesy tak, by sąsiedzi w drzewie leżeli blisko siebie w sieci.
+void raymond_init(RaymondNode* node, int world_rank, int num_procs) {
+    bool is_root = (world_rank == 0);
+    int first_child = world_rank * TREE_ARITY + 1;
+    int num_children = num_procs - first_child;
+    num_children = num_children < 0 ? 0 : (num_children > TREE_ARITY ? TREE_ARITY : num_children);
+    int degree = (is_root ? 0 : 1) + num_children;
+
+    // Tablice co najmniej jednoelementowe - samotny korzeń (N = 1) nie ma sąsiadów. Wagi są jednakowe;
+    // podajemy je zamiast MPI_UNWEIGHTED (w Open MPI wskaźnik-znacznik, na którym gcc zgłasza odczyt poza tablicą).
+    int size = degree > 0 ? degree : 1;
+    int* neighbors = malloc(size * sizeof(int));
+    int weights[size];
+    int count = 0;
+    if (!is_root) {
+        neighbors[count++] = (world_rank - 1) / TREE_ARITY; // Rodzic zawsze jako pierwszy sąsiad
+    }
+    for (int c = 0; c < num_children; c++) {
+        neighbors[count++] = first_child + c;
+    }
+    for (int i = 0; i < size; i++) {
+        weights[i] = 1;
+    }
+
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD, degree, neighbors, weights,
+                                   degree, neighbors, weights,
+                                   MPI_INFO_NULL, TREE_REORDER, &node->comm);
+    MPI_Comm_rank(node->comm, &node->my_rank);
+
+    // Sąsiedzi w numeracji nowego komunikatora (kolejność taka sama jak przy tworzeniu). Graf jest
+    // symetryczny, więc wystarczą sąsiedzi wychodzący - źródeł nie pobieramy (maxindegree = 0).
+    node->degree = degree;
+    node->neighbors = neighbors;
+    MPI_Dist_graph_neighbors(node->comm, 0, NULL, NULL, degree, node->neighbors, weights);
+
+    node->parent = is_root ? SELF : node->neighbors[0];
+    node->num_children = is_root ? degree : degree - 1;
+    node->clock = 0;
+
+    node->holder = is_root ? SELF : node->parent; // Na początku token jest w korzeniu
+    node->using = false;
+    node->asked = false;
+    node->request_q = malloc((degree + 1) * sizeof(int));
+    node->q_head = 0;
+    node->q_size = 0;
+
+    node->done_children = 0;
+    node->shutdown = false;
+}
+
+// Zwalnia zasoby węzła.
+void raymond_free(RaymondNode* node) {
+    free(node->neighbors);
+    free(node->request_q);
+    MPI_Comm_free(&node->comm);
+}
+
+// Wysyła wiadomość do sąsiada w drzewie.
+void send_message(RaymondNode* node, int target, MessageType type) {
+    node->clock++; // Zdarzenie lokalne: wysłanie wiadomości
+    Message msg_out = {type, node->clock, node->my_rank};
+    MPI_Send(&msg_out, sizeof(Message), MPI_BYTE, target, 0, node->comm);
+    bench_message_sent(node->stats, type, 0);
+    trace_event(node->trace, TRACE_SEND, node->clock, target, type, -1);
+}
+
+// Dopisuje żądanie (sąsiada lub SELF) na koniec kolejki.
+void enqueue_request(RaymondNode* node, int who) {
+    node->request_q[(node->q_head + node->q_size) % (node->degree + 1)] = who;
+    node->q_size++;
+}
+
+// ASSIGN_PRIVILEGE: jeśli mam wolny token, a ktoś czeka - przekazuję go pierwszemu z kolejki
+// (albo sam wchodzę do sekcji krytycznej, jeśli to moje żądanie).
+void assign_privilege(RaymondNode* node) {
+    if (node->holder != SELF || node->using || node->q_size == 0) return;
+
+    node->holder = node->request_q[node->q_head];
+    node->q_head = (node->q_head + 1) % (node->degree + 1);
+    node->q_size--;
+    node->asked = false;
+    if (node->holder == SELF) {
+        node->using = true;
+    } else {
+        send_message(node, node->holder, MSG_PRIVILEGE);
+    }
+}
+
+// MAKE_REQUEST: jeśli nie mam tokenu, a ktoś czeka - proszę holdera o token (tylko raz).
+void make_request(RaymondNode* node) {
+    if (node->holder == SELF || node->q_size == 0 || node->asked) return;
+
+    send_message(node, node->holder, MSG_REQ);
+    node->asked = true;
+}
+
+// Przetwarza odebraną wiadomość.
+void handle_message(RaymondNode* node, Message msg_in) {
+    // Aktualizacja zegara Lamporta na podstawie odebranej wiadomości
+    node->clock = max(node->clock, msg_in.timestamp) + 1;
+    bench_message_received(node->stats, msg_in.type, 0);
+    trace_event(node->trace, TRACE_RECV, node->clock, msg_in.sender_rank, msg_in.type, -1);
+    LOG(2, "--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od sąsiada %d (ts=%d).\n", node->my_rank, node->clock, get_message_type_name(msg_in.type), msg_in.sender_rank, msg_in.timestamp);
+
+    if (msg_in.type == MSG_REQ) { // Żądanie od sąsiada
+        enqueue_request(node, msg_in.sender_rank);
+    } else if (msg_in.type == MSG_PRIVILEGE) { // Token przyszedł do mnie
+        node->holder = SELF;
+    } else if (msg_in.type == MSG_DONE) {
+        node->done_children++;
+    } else if (msg_in.type == MSG_SHUTDOWN) {
+        node->shutdown = true;
+    }
+    assign_privilege(node);
+    make_request(node);
+}
+
+int main(int argc, char* argv[]) {
+    int my_rank, num_procs; // Ranga bieżącego procesu i całkowita liczba procesów
+    MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);    // Pobranie rangi bieżącego procesu
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);  // Pobranie całkowitej liczby procesów
+
+    Workload workload; // Parametry obciążenia (linia poleceń / zmienne środowiskowe)
+    workload_init(&workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, 1);
+    BenchStats stats; // Pomiary benchmarku
+    bench_init(&stats, workload.operations);
+
+    RaymondNode node; // Stan węzła drzewa (tylko sąsiedzi, kolejka żądań i kierunek tokenu)
+    raymond_init(&node, my_rank, num_procs);
+
+    // Ślad zdarzeń (zapisywany tylko przy --trace-dir / TRACE_DIR) - w numeracji komunikatora drzewa,
+    // w której są też rangi partnerów wiadomości
+    const char* message_names[MSG_SHUTDOWN + 1];
+    for (int t = 0; t <= MSG_SHUTDOWN; t++) message_names[t] = get_message_type_name(t);
+    Trace trace;
+    trace_init(&trace, argc, argv, "raymond", node.my_rank, num_procs, message_names, MSG_SHUTDOWN + 1);
+    static Metrics metrics; // Rejestr metryk (liczniki zawsze, migawki przy --metrics-ms / BENCH_METRICS_MS)
+    metrics_init(&metrics, argc, argv, "raymond", my_rank, num_procs, message_names, MSG_SHUTDOWN + 1, 0);
+    stats.metrics = &metrics;
+    node.stats = &stats;
+    node.trace = &trace;
+
+    RecvEngine recv_engine; // Silnik odbioru wiadomości (stałe żądania odbioru)
+    recv_engine_init(&recv_engine, sizeof(Message), node.comm);
+
+    // Inicjalizacja generatora liczb losowych (stałe ziarno daje powtarzalne obciążenie)
+    srand(workload.seed >= 0 ? (unsigned)(workload.seed + my_rank) : (unsigned)(my_rank * time(NULL)));
+
+    bench_start(&stats); // Wspólny początek pomiaru
+    metrics_start(&metrics);
+
+    // Główna pętla symulująca operacje kradzieży
+    for (int op_count = 0; op_count < workload.operations; op_count++) {
+        // --- PRÓBA WEJŚCIA DO SEKCJI KRYTYCZNEJ ---
+        LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Liczba sąsiadów w drzewie: %d.\n", my_rank, node.clock, op_count + 1, node.degree);
+        node.clock++; // Zdarzenie lokalne: inkrementacja zegara Lamporta
+        int target_house_id = (my_rank + op_count) % workload.houses; // Symboliczny wybór domu do okradzenia
+        bench_request(&stats, 0, false); // Jedna sekcja krytyczna (jeden token) dla wszystkich domów
+        trace_event(&trace, TRACE_CS_REQUEST, node.clock, -1, -1, target_house_id);
+
+        // Moje żądanie trafia do lokalnej kolejki; żądanie idzie tylko w stronę tokenu (O(log N) przeskoków)
+        enqueue_request(&node, SELF);
+        assign_privilege(&node);
+        make_request(&node);
+
+        // Pętla oczekiwania na token (w międzyczasie przekazuję żądania i token sąsiadom)
+        while (!node.using) {
+            Message msg_in;
+            recv_engine_next(&recv_engine, &msg_in);
+            handle_message(&node, msg_in);
+        }
+
+        // --- WEJŚCIE DO SEKCJI KRYTYCZNEJ ---
+        node.clock++; // Zdarzenie lokalne: inkrementacja zegara
+        bench_enter(&stats);
+        trace_event(&trace, TRACE_CS_ENTER, node.clock, -1, -1, target_house_id);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, node.clock, target_house_id);
+
+        usleep(workload_random_us(workload.cs_min_us, workload.cs_max_us)); // Symulacja czasu trwania kradzieży
+
+        // --- WYJŚCIE Z SEKCJI KRYTYCZNEJ ---
+        node.clock++; // Zdarzenie lokalne: inkrementacja zegara
+        bench_exit(&stats);
+        trace_event(&trace, TRACE_CS_EXIT, node.clock, -1, -1, target_house_id);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Przekazuję token dalej, jeśli ktoś czeka.\n", my_rank, node.clock);
+        node.using = false;
+
+        // Obsłużenie żądań, które przyszły w czasie sekcji krytycznej, i przekazanie tokenu
+        Message msg_in;
+        while (recv_engine_try_next(&recv_engine, &msg_in)) {
+            handle_message(&node, msg_in);
+        }
+        assign_privilege(&node);
+        make_request(&node);
+
+        LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d. Odpoczywam przed kolejną próbą.\n", my_rank, node.clock, op_count + 1);
+        trace_flush(&trace); // Zrzut śladu poza sekcją krytyczną i pętlą oczekiwania
+        metrics_tick(&metrics, node.clock); // Migawki za minione okresy
+        usleep(workload_random_us(workload.think_min_us, workload.think_max_us)); // Symulacja odpoczynku
+    }
+    bench_finish(&stats); // Koniec pomiaru
+    node.stats = NULL; // Dalsze wiadomości (pośrednictwo dla innych, DONE/SHUTDOWN) są poza pomiarem
+
+    // Zakończenie pracy: gdy ja i wszystkie moje poddrzewa skończyły, informuję rodzica (DONE).
+    // Korzeń, wiedząc że całe drzewo skończyło, rozsyła SHUTDOWN w dół. Do tego czasu nadal
+    // przekazuję żądania i token, bo inne procesy mogą potrzebować mnie jako pośrednika.
+    trace_event(&trace, TRACE_FINISH, node.clock, -1, -1, -1);
+    LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Pośredniczę, dopóki inni pracują.\n", my_rank, node.clock);
+    bool done_sent = false;
+    while (true) {
+        if (!done_sent && node.done_children == node.num_children) {
+            if (node.parent == SELF) {
+                node.shutdown = true; // Jestem korzeniem: całe drzewo zakończyło pracę
+            } else {
+                send_message(&node, node.parent, MSG_DONE);
+            }
+            done_sent = true;
+        }
+        if (node.shutdown) break;
+
+        Message msg_in;
+        recv_engine_next(&recv_engine, &msg_in);
+        handle_message(&node, msg_in);
+    }
+    for (int i = 0; i < node.degree; i++) { // Przekazanie sygnału końca pracy do dzieci
+        if (node.neighbors[i] != node.parent) {
+            send_message(&node, node.neighbors[i], MSG_SHUTDOWN);
+        }
+    }
+    LOG(1, "--- Proces %d --- [Zegar: %d] Wszystkie procesy zakończyły pracę. Finalizuję pracę.\n", my_rank, node.clock);
+
+    metrics_finish(&metrics, node.clock); // Migawka końcowa (operacja zbiorowa)
+    bench_report(&stats, &workload, "raymond", my_rank, num_procs); // Raport benchmarku (proces 0; operacja zbiorowa)
+    bench_free(&stats);
+    metrics_free(&metrics);
+    trace_close(&trace); // Zrzut reszty śladu przed MPI_Finalize
+    recv_engine_free(&recv_engine); // Zwolnienie stałych żądań odbioru
+    raymond_free(&node);
+    MPI_Finalize(); // Zakończenie pracy środowiska MPI
+    return 0;
+}
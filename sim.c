@@ -0,0 +1,486 @@
+// Symulator zdarzeń dyskretnych dla protokołów wzajemnego wykluczania z na3.c i nowa.c.
+// Jeden proces bez MPI odtwarza N procesów w czasie wirtualnym. Każdy symulowany proces ma własny zbiór
+// blokad z lockset.h (te same maszyny stanów co programy: kolejki Lamporta z oglądającymi i dzierżawą,
+// Ricart-Agrawala ze zgodami Roucairola-Carvalho, sklejanie zdarzeń w skrzynce nadawczej), a wiadomości
+// przechodzą przez transport symulatora - model opóźnień zamiast sieci. Dzięki temu można przeglądać N
+// i poziom rywalizacji o rzędy wielkości szybciej niż w czasie rzeczywistym i bez tylu procesów MPI.
+//
+// Model:
+//   - wysłanie: nadawca wysyła wiadomości po kolei, każda zajmuje mu --send-us (rozgłoszenie do N-1
+//     procesów trwa więc (N-1)*send_us); dostarczenie po --latency-us + losowe [0, --jitter-us],
+//   - kolejność FIFO między parą procesów jest zachowana jak w MPI (wiadomość nie wyprzedza wcześniejszej),
+//   - na3.c (--protocol=lamport) odbiera wiadomości tylko w pętli oczekiwania na sekcję, więc w czasie
+//     sekcji i odpoczynku czekają w skrzynce procesu; wyjątki jak w na3.c: oglądający w sekcji i dzierżawca
+//     w czasie odpoczynku obsługują je co --poll-us. Tak samo nowa.c bez wątku postępu (--protocol=ra),
+//     a z --progress-thread=1 obsługuje je od razu. Proces po ostatniej operacji obsługuje wiadomości od razu,
+//   - oględziny (--read-pct) i dzierżawa (--lease-ops, --lease-ms) jak w na3.c; w trybie ra same kradzieże,
+//   - czasy sekcji i odpoczynku są losowane jak w programach (--cs-min-us ... --think-max-us),
+//     ze stałym ziarnem (--seed, domyślnie 1), a remisy czasu rozstrzyga kolejność zdarzeń - wynik jest powtarzalny.
+//
+// Raport ma ten sam format co raport benchmarku (bench_print_report z bench.h, czasy wirtualne; wiadomości
+// liczone jak w programach - do ostatniej operacji nadawcy), a na stderr symulator dopisuje rozmiary
+// kolejek, liczbę zdarzeń i przyspieszenie względem czasu rzeczywistego.
+// Symulator sprawdza też wzajemne wykluczanie (czytelnicy-pisarze) - naruszenie kończy go z błędem.
+//
+// Kompilacja: cc -O2 -o sim sim.c
+// Użycie:     ./sim --procs=1000 --protocol=ra --ops=5 --latency-us=20 --report=csv
+// Pamięć i liczba wiadomości obu protokołów rosną jak N^2 (każdy proces zna wszystkich), więc
+// dla dużego N trzeba zmniejszyć --ops.
+#define LOCKSET_NO_MPI
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "lockset.h"  // Protokoły (bez MPI), parametry obciążenia i raport
+#include "walltime.h" // Czas rzeczywisty (dla przyspieszenia)
+
+#define NUM_PROCS 8         // Liczba symulowanych procesów (domyślnie; --procs / SIM_PROCS)
+#define NUM_OPERATIONS 2    // Ile razy każdy proces wchodzi do sekcji (domyślnie; --ops / BENCH_OPS)
+#define NUM_HOUSES_TOTAL 5  // Tylko do raportu - sekcja kradzieży jest jedna dla wszystkich domów (zasób 0, jak w na3.c)
+#define LATENCY_US 20       // Opóźnienie sieci (domyślnie; --latency-us / SIM_LATENCY_US)
+#define JITTER_US 10        // Losowy dodatek do opóźnienia (domyślnie; --jitter-us / SIM_JITTER_US)
+#define SEND_US 1           // Czas wysłania jednej wiadomości przez nadawcę (domyślnie; --send-us / SIM_SEND_US)
+#define READ_POLL_US 500    // Co ile oglądający w sekcji i dzierżawca obsługują wiadomości (jak w na3.c; --poll-us / SIM_POLL_US)
+#define LEASE_OPS 1         // Dzierżawa jak w na3.c (--lease-ops / BENCH_LEASE_OPS; 1 = bez dzierżawy)
+#define LEASE_MS 100        //   i jej najdłuższy czas (--lease-ms / BENCH_LEASE_MS)
+
+// Rodzaje zdarzeń symulacji
+typedef enum {
+    EV_WAKE,      // Proces kończy odpoczynek i ubiega się o sekcję
+    EV_CS_DONE,   // Proces kończy sekcję krytyczną
+    EV_DELIVER,   // Wiadomość dociera do odbiorcy
+    EV_POLL       // Oglądający w sekcji albo dzierżawca obsługuje wiadomości (lock_poll)
+} EventKind;
+
+// Zdarzenie. Rozgłoszenie jest jednym zdarzeniem, które po dostarczeniu do odbiorcy target wraca do kopca
+// z czasem dostarczenia do następnego - kopiec ma więc rozmiar rzędu liczby wiadomości w locie "na nadawcę",
+// a nie N na każde rozgłoszenie.
+typedef struct {
+    double time;      // Chwila zdarzenia (mikrosekundy czasu wirtualnego)
+    long seq;         // Numer utworzenia - rozstrzyga remisy czasu (deterministycznie)
+    EventKind kind;
+    int rank;         // Proces (EV_WAKE, EV_CS_DONE, EV_POLL) albo nadawca (EV_DELIVER)
+    int target, end;  // EV_DELIVER: bieżący odbiorca i koniec zakresu odbiorców [target, end) (bez nadawcy);
+                      // EV_POLL: numer okresu obsługi (target), starsze są pomijane
+    double depart;    // EV_DELIVER: chwila wysłania do bieżącego odbiorcy
+    Message msg;
+} Event;
+
+// Skrzynka procesu: wiadomości, które dotarły, a proces ich jeszcze nie obsłużył (FIFO)
+typedef struct {
+    Message* items;
+    int head, count, capacity;
+} Inbox;
+
+typedef struct Sim Sim;
+
+// Stan symulowanego procesu
+typedef struct {
+    Sim* sim;
+    int rank;
+    int ops_done;               // Zakończone operacje
+    bool waiting;               // Czeka na wejście do sekcji (odbiera wiadomości)
+    bool in_cs;
+    AccessMode mode;            // Tryb bieżącej operacji
+    int poll_period;            // Numer bieżącego okresu obsługi wiadomości co poll_us
+    Inbox inbox;
+    LockSet locks;              // Zbiór blokad (transport: ten proces jako kontekst)
+    BenchStats stats;
+} SimProc;
+
+typedef enum {
+    PROTOCOL_LAMPORT,
+    PROTOCOL_RA
+} Protocol;
+
+// Stan symulacji
+struct Sim {
+    Protocol protocol;
+    bool progress_thread;  // nowa.c z wątkiem postępu: wiadomości obsługiwane od razu
+    int num_procs;
+    Workload workload;
+    int latency_us, jitter_us, send_us, poll_us;
+    double now;
+
+    Event* events;         // Kopiec zdarzeń (min wg czasu, potem seq)
+    int num_events, events_capacity;
+    long next_seq;
+    long events_processed;
+
+    SimProc* procs;
+    OutBox outbox;         // Wspólna skrzynka nadawcza - krok jednego procesu kończy się lock_flush
+    double* link_free;     // Chwila, od której nadawca może wysłać kolejną wiadomość
+    double* last_arrival;  // Górna granica dostarczenia ostatniej wiadomości nadawcy (FIFO)
+
+    int readers, writers;  // Sprawdzenie wzajemnego wykluczania
+    double queue_sum;      // Długość kolejki/listy odłożonych zgód przy wejściu do sekcji
+    int queue_max;
+    double end_time;
+};
+
+bool event_before(const Event* a, const Event* b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+void sim_push(Sim* sim, Event ev) {
+    if (sim->num_events == sim->events_capacity) {
+        sim->events_capacity *= 2;
+        sim->events = realloc(sim->events, sim->events_capacity * sizeof(Event));
+    }
+    ev.seq = sim->next_seq++;
+    int i = sim->num_events++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!event_before(&ev, &sim->events[parent])) break;
+        sim->events[i] = sim->events[parent];
+        i = parent;
+    }
+    sim->events[i] = ev;
+}
+
+Event sim_pop(Sim* sim) {
+    Event top = sim->events[0];
+    Event last = sim->events[--sim->num_events];
+    int i = 0;
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= sim->num_events) break;
+        if (child + 1 < sim->num_events && event_before(&sim->events[child + 1], &sim->events[child])) {
+            child++;
+        }
+        if (!event_before(&sim->events[child], &last)) break;
+        sim->events[i] = sim->events[child];
+        i = child;
+    }
+    if (sim->num_events > 0) sim->events[i] = last;
+    return top;
+}
+
+void sim_schedule(Sim* sim, EventKind kind, int rank, double time) {
+    Event ev = {.time = time, .kind = kind, .rank = rank};
+    sim_push(sim, ev);
+}
+
+// Pomija nadawcę w zakresie odbiorców.
+int skip_sender(int target, int sender) {
+    return target == sender ? target + 1 : target;
+}
+
+// Wysyła wiadomość do procesów [first, end) z pominięciem nadawcy.
+void sim_send(Sim* sim, int sender, const Message* msg, int first, int end) {
+    first = skip_sender(first, sender);
+    int count = end - first - (sender > first && sender < end ? 1 : 0);
+    if (count <= 0) return;
+
+    // Nadawca wysyła po kolei: zajmuje łącze na count * send_us
+    double depart = (sim->now > sim->link_free[sender] ? sim->now : sim->link_free[sender]) + sim->send_us;
+    sim->link_free[sender] = depart + (count - 1) * sim->send_us;
+    double arrival = depart + sim->latency_us + workload_random_us(0, sim->jitter_us);
+    if (arrival < sim->last_arrival[sender]) arrival = sim->last_arrival[sender]; // FIFO względem wcześniejszych
+    sim->last_arrival[sender] = sim->link_free[sender] + sim->latency_us + sim->jitter_us;
+
+    Event ev = {.time = arrival, .kind = EV_DELIVER, .rank = sender, .target = first, .end = end,
+                .depart = depart, .msg = *msg};
+    sim_push(sim, ev);
+}
+
+void inbox_push(Inbox* inbox, Message msg) {
+    if (inbox->count == inbox->capacity) {
+        int capacity = inbox->capacity ? 2 * inbox->capacity : 16;
+        Message* items = malloc(capacity * sizeof(Message));
+        for (int i = 0; i < inbox->count; i++) {
+            items[i] = inbox->items[(inbox->head + i) % inbox->capacity];
+        }
+        free(inbox->items);
+        inbox->items = items;
+        inbox->head = 0;
+        inbox->capacity = capacity;
+    }
+    inbox->items[(inbox->head + inbox->count) % inbox->capacity] = msg;
+    inbox->count++;
+}
+
+Message inbox_pop(Inbox* inbox) {
+    Message msg = inbox->items[inbox->head];
+    inbox->head = (inbox->head + 1) % inbox->capacity;
+    inbox->count--;
+    return msg;
+}
+
+// --- Transport symulatora (LockTransport, kontekst: SimProc) ---
+
+// Paczka kroku protokołu. Kolejni odbiorcy (z pominięciem nadawcy) z identyczną wiadomością idą jednym
+// zdarzeniem rozgłoszenia - zwykłe rozgłoszenie REQ/REL kosztuje więc jedno zdarzenie zamiast N-1.
+void sim_transport_send(void* ctx, const Message* msgs, const int* targets, int count) {
+    SimProc* proc = ctx;
+    int first = 0;
+    for (int k = 1; k <= count; k++) {
+        bool next_in_range = k < count && memcmp(&msgs[k], &msgs[first], sizeof(Message)) == 0 &&
+                             skip_sender(targets[k - 1] + 1, proc->rank) == targets[k];
+        if (next_in_range) continue;
+        sim_send(proc->sim, proc->rank, &msgs[first], targets[first], targets[k - 1] + 1);
+        first = k;
+    }
+}
+
+bool sim_transport_try_recv(void* ctx, Message* msg) {
+    SimProc* proc = ctx;
+    if (proc->inbox.count == 0) return false;
+    *msg = inbox_pop(&proc->inbox);
+    return true;
+}
+
+// Symulator woła lock_wait tylko przy niepustej skrzynce (czekanie to kolejne zdarzenia dostarczenia).
+void sim_transport_recv(void* ctx, Message* msg) {
+    SimProc* proc = ctx;
+    *msg = inbox_pop(&proc->inbox);
+}
+
+// --- Procesy ---
+
+int sim_queue_length(SimProc* proc) {
+    return proc->locks.ra_permission ? proc->locks.deferred_count : proc->locks.house_queues[0].size;
+}
+
+// Oglądający w sekcji (lock_work w na3.c) i dzierżawca w czasie odpoczynku (lock_idle) obsługują
+// wiadomości co poll_us.
+bool sim_polling(SimProc* proc) {
+    if (proc->in_cs) return proc->mode == ACCESS_SHARED;
+    return !proc->waiting && proc->locks.lease_house != -1;
+}
+
+void sim_start_polling(Sim* sim, SimProc* proc) {
+    if (sim->poll_us <= 0 || !sim_polling(proc)) return;
+    Event ev = {.time = sim->now + sim->poll_us, .kind = EV_POLL, .rank = proc->rank, .target = ++proc->poll_period};
+    sim_push(sim, ev);
+}
+
+// Wejście do sekcji: sprawdzenie wykluczania, długość kolejki i zaplanowanie wyjścia
+// (pomiary zapisał już lock_try_acquire).
+void sim_enter(Sim* sim, SimProc* proc) {
+    proc->waiting = false;
+    proc->in_cs = true;
+    bool violation;
+    if (proc->mode == ACCESS_SHARED) {
+        violation = sim->writers > 0;
+        sim->readers++;
+    } else {
+        violation = sim->writers > 0 || sim->readers > 0;
+        sim->writers++;
+    }
+    if (violation) {
+        fprintf(stderr, "Naruszenie wzajemnego wykluczania: proces %d wszedł do zajętej sekcji (t=%.1f us)\n",
+                proc->rank, sim->now);
+        exit(1);
+    }
+    int queue_length = sim_queue_length(proc);
+    sim->queue_sum += queue_length;
+    if (queue_length > sim->queue_max) sim->queue_max = queue_length;
+    sim_schedule(sim, EV_CS_DONE, proc->rank,
+                 sim->now + workload_random_us(sim->workload.cs_min_us, sim->workload.cs_max_us));
+    sim_start_polling(sim, proc);
+}
+
+// Pętla oczekiwania programów (while (!lock_try_acquire) lock_wait) - wiadomości ze skrzynki po jednej,
+// dopóki nie można wejść. Pusta skrzynka: proces czeka na kolejne dostarczenie.
+void sim_try_enter(Sim* sim, SimProc* proc) {
+    while (!lock_try_acquire(&proc->locks, 0, proc->mode)) {
+        if (proc->inbox.count == 0) return;
+        lock_wait(&proc->locks);
+    }
+    sim_enter(sim, proc);
+}
+
+// Czy proces obsługuje wiadomość od razu (czeka na sekcję, skończył pracę albo ma wątek postępu).
+bool sim_receiving(Sim* sim, SimProc* proc) {
+    return proc->waiting || proc->ops_done == sim->workload.operations || proc->locks.external_progress;
+}
+
+void sim_deliver(Sim* sim, int target, Message msg) {
+    SimProc* proc = &sim->procs[target];
+    inbox_push(&proc->inbox, msg);
+    if (!sim_receiving(sim, proc)) return;
+    if (proc->waiting) {
+        sim_try_enter(sim, proc);
+        return;
+    }
+    while (proc->inbox.count > 0) {
+        lock_wait(&proc->locks);
+    }
+}
+
+void sim_wake(Sim* sim, SimProc* proc) {
+    proc->mode = sim->protocol == PROTOCOL_LAMPORT && workload_random_read(&sim->workload) ? ACCESS_SHARED
+                                                                                          : ACCESS_EXCLUSIVE;
+    proc->waiting = true;
+    sim_try_enter(sim, proc);
+}
+
+void sim_cs_done(Sim* sim, SimProc* proc) {
+    proc->in_cs = false;
+    if (proc->mode == ACCESS_SHARED) {
+        sim->readers--;
+    } else {
+        sim->writers--;
+    }
+    bool last = (++proc->ops_done == sim->workload.operations);
+    lock_release(&proc->locks, 0, last);
+    lock_flush(&proc->locks);
+    if (!last) {
+        sim_schedule(sim, EV_WAKE, proc->rank,
+                     sim->now + workload_random_us(sim->workload.think_min_us, sim->workload.think_max_us));
+        sim_start_polling(sim, proc); // Z dzierżawą
+        return;
+    }
+    // Jak lock_runtime_finish: dalsza obsługa nie jest liczona, a zakończony proces odbiera od razu
+    proc->locks.stats = NULL;
+    if (sim->now > sim->end_time) sim->end_time = sim->now;
+    while (proc->inbox.count > 0) {
+        lock_wait(&proc->locks);
+    }
+}
+
+void sim_poll(Sim* sim, SimProc* proc, int period) {
+    if (period != proc->poll_period || !sim_polling(proc)) return; // Okres obsługi już się skończył
+    lock_poll(&proc->locks);
+    sim_start_polling(sim, proc);
+}
+
+// --- Pętla symulacji ---
+
+void sim_process(Sim* sim, Event ev) {
+    SimProc* proc = &sim->procs[ev.kind == EV_DELIVER ? ev.target : ev.rank];
+    switch (ev.kind) {
+        case EV_WAKE:
+            sim_wake(sim, proc);
+            break;
+        case EV_CS_DONE:
+            sim_cs_done(sim, proc);
+            break;
+        case EV_POLL:
+            sim_poll(sim, proc, ev.target);
+            break;
+        case EV_DELIVER: {
+            sim_deliver(sim, ev.target, ev.msg);
+            // Rozgłoszenie: następny odbiorca (nie wcześniej niż poprzedni - FIFO nadawcy)
+            int next = skip_sender(ev.target + 1, ev.rank);
+            if (next < ev.end) {
+                ev.target = next;
+                ev.depart += sim->send_us;
+                double arrival = ev.depart + sim->latency_us + workload_random_us(0, sim->jitter_us);
+                ev.time = arrival > sim->now ? arrival : sim->now;
+                sim_push(sim, ev);
+            }
+            break;
+        }
+    }
+    lock_flush(&proc->locks); // Skrzynka nadawcza jest wspólna - nic nie może przejść na krok innego procesu
+}
+
+void sim_init(Sim* sim, int argc, char** argv) {
+    workload_init(&sim->workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, 1);
+    if (sim->workload.report[0] == '\0') snprintf(sim->workload.report, sizeof(sim->workload.report), "csv");
+    sim->num_procs = bench_int_option(argc, argv, "procs", "SIM_PROCS", NUM_PROCS);
+    if (sim->num_procs < 1) sim->num_procs = 1;
+    const char* protocol = bench_option(argc, argv, "protocol", "SIM_PROTOCOL");
+    sim->protocol = protocol && strcmp(protocol, "ra") == 0 ? PROTOCOL_RA : PROTOCOL_LAMPORT;
+    sim->progress_thread = bench_int_option(argc, argv, "progress-thread", "BENCH_PROGRESS_THREAD", 0) != 0;
+    sim->latency_us = bench_int_option(argc, argv, "latency-us", "SIM_LATENCY_US", LATENCY_US);
+    sim->jitter_us = bench_int_option(argc, argv, "jitter-us", "SIM_JITTER_US", JITTER_US);
+    sim->send_us = bench_int_option(argc, argv, "send-us", "SIM_SEND_US", SEND_US);
+    sim->poll_us = bench_int_option(argc, argv, "poll-us", "SIM_POLL_US", READ_POLL_US);
+    int lease_ops = bench_int_option(argc, argv, "lease-ops", "BENCH_LEASE_OPS", LEASE_OPS);
+    int lease_ms = bench_int_option(argc, argv, "lease-ms", "BENCH_LEASE_MS", LEASE_MS);
+    srand(sim->workload.seed >= 0 ? (unsigned)sim->workload.seed : 1u);
+
+    int n = sim->num_procs;
+    sim->now = 0.0;
+    bench_virtual_now = 0.0;
+    sim->events_capacity = 2 * n;
+    sim->events = malloc(sim->events_capacity * sizeof(Event));
+    sim->num_events = 0;
+    sim->next_seq = 0;
+    sim->events_processed = 0;
+    outbox_init(&sim->outbox, n);
+    sim->link_free = calloc(n, sizeof(double));
+    sim->last_arrival = calloc(n, sizeof(double));
+    sim->readers = sim->writers = 0;
+    sim->queue_sum = 0.0;
+    sim->queue_max = 0;
+    sim->end_time = 0.0;
+
+    sim->procs = calloc(n, sizeof(SimProc));
+    for (int r = 0; r < n; r++) {
+        SimProc* proc = &sim->procs[r];
+        proc->sim = sim;
+        proc->rank = r;
+        bench_init(&proc->stats, sim->workload.operations);
+        LockTransport transport = {proc, sim_transport_send, sim_transport_try_recv, sim_transport_recv, NULL, NULL};
+        lock_set_init(&proc->locks, r, n, 1, NULL, &sim->outbox, transport, &proc->stats, NULL);
+        if (sim->protocol == PROTOCOL_RA) {
+            lock_set_use_ra(&proc->locks);
+            proc->locks.external_progress = sim->progress_thread;
+        } else {
+            proc->locks.lease_ops = lease_ops;
+            proc->locks.lease_s = lease_ms / 1000.0;
+        }
+        if (sim->workload.operations > 0) sim_schedule(sim, EV_WAKE, r, 0.0);
+    }
+}
+
+void sim_free(Sim* sim) {
+    for (int r = 0; r < sim->num_procs; r++) {
+        SimProc* proc = &sim->procs[r];
+        lock_set_free(&proc->locks);
+        bench_free(&proc->stats);
+        free(proc->inbox.items);
+    }
+    free(sim->procs);
+    free(sim->events);
+    outbox_free(&sim->outbox);
+    free(sim->link_free);
+    free(sim->last_arrival);
+}
+
+int main(int argc, char* argv[]) {
+    Sim sim;
+    sim_init(&sim, argc, argv);
+
+    double real_start = wall_time();
+    while (sim.num_events > 0) {
+        Event ev = sim_pop(&sim);
+        sim.now = ev.time;
+        bench_virtual_now = ev.time / 1e6; // Pomiary zbioru blokad (bench_now) w czasie wirtualnym
+        sim_process(&sim, ev);
+        sim.events_processed++;
+    }
+    double real_elapsed = wall_time() - real_start;
+
+    // Wejścia wszystkich procesów do jednego raportu
+    long expected = (long)sim.num_procs * sim.workload.operations;
+    CsRecord* records = malloc((expected > 0 ? expected : 1) * sizeof(CsRecord));
+    int entries = 0;
+    long messages_sent = 0;
+    for (int r = 0; r < sim.num_procs; r++) {
+        BenchStats* stats = &sim.procs[r].stats;
+        memcpy(&records[entries], stats->records, stats->entries * sizeof(CsRecord));
+        entries += stats->entries;
+        messages_sent += stats->messages_sent;
+    }
+    if (entries != expected) { // Zakleszczenie: ktoś czeka na wiadomość, która nie przyjdzie
+        fprintf(stderr, "Symulacja utknęła: %d z %ld wejść\n", entries, expected);
+        return 1;
+    }
+
+    const char* program = sim.protocol == PROTOCOL_LAMPORT ? "sim-lamport" :
+                          sim.progress_thread ? "sim-ra+progress" : "sim-ra";
+    bench_print_report(records, entries, messages_sent, sim.end_time / 1e6, &sim.workload, program, sim.num_procs);
+    fprintf(stderr, "# %s: latency_us=%d jitter_us=%d send_us=%d queue_mean=%.2f queue_max=%d events=%ld real_s=%.3f speedup=%.1f\n",
+            program, sim.latency_us, sim.jitter_us, sim.send_us,
+            entries > 0 ? sim.queue_sum / entries : 0.0, sim.queue_max, sim.events_processed, real_elapsed,
+            real_elapsed > 0 ? (sim.end_time / 1e6) / real_elapsed : 0.0);
+
+    free(records);
+    sim_free(&sim);
+    return 0;
+}
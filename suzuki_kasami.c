@@ -0,0 +1,311 @@
+#include <mpi.h>         // MPI biblioteka do komunikacji międzyprocesowej
+#include <stdio.h>       // Standardowe wejście/wyjście (np. printf)
+#include <stdlib.h>      // Standardowe funkcje biblioteczne (np. rand, malloc)
+#include <string.h>      // Funkcje do operacji na stringach (nieużywane bezpośrednio, ale często przydatne)
+#include <unistd.h>      // Dla funkcji usleep (pauza)
+#include <time.h>        // Dla funkcji time() (inicjalizacja generatora liczb losowych)
+#include <stdbool.h>     // Dla typów bool, true, false
+#include "bench.h"       // Parametry obciążenia i pomiary benchmarku
+#include "trace.h"       // Binarny ślad zdarzeń i poziomy logowania (LOG_LEVEL)
+#include "metrics.h"     // Rejestr metryk protokołu (migawki --metrics-ms)
+#include "transport.h"   // Odbiór wiadomości na stałych żądaniach MPI (RecvEngine)
+
+#define NUM_HOUSES_TOTAL 2 // Całkowita liczba domów (domyślnie; --houses / BENCH_HOUSES)
+#define NUM_OPERATIONS 2   // Ile razy każdy proces (złodziej) spróbuje coś ukraść (domyślnie; --ops / BENCH_OPS)
+
+#define TOKEN_HOLDER_AT_START 0 // Proces, który posiada token na początku
+#define TOKEN_TAG 1             // Tag, pod którym przesyłana jest zawartość tokenu (tablica LN i kolejka Q)
+
+// Typy wiadomości używane w komunikacji MPI (algorytm Suzuki-Kasami)
+typedef enum {
+    MSG_REQ,         // Żądanie tokenu (Request) z numerem żądania nadawcy
+    MSG_TOKEN,       // Przekazanie tokenu; zawartość tokenu idzie osobną wiadomością z tagiem TOKEN_TAG
+    MSG_TERMINATE    // Wiadomość informująca o zakończeniu pracy przez proces
+} MessageType;
+
+// Struktura wiadomości przesyłanej między procesami
+typedef struct {
+    MessageType type;      // Typ wiadomości (z enum MessageType)
+    int timestamp;         // Zegar Lamporta nadawcy wiadomości (tylko do logowania)
+    int sender_rank;       // Ranga (ID) procesu wysyłającego wiadomość
+    int request_number;    // Numer żądania nadawcy (RN) - tylko dla MSG_REQ
+} Message;
+
+// Token algorytmu Suzuki-Kasami
+typedef struct {
+    int* last_served;  // LN[j]: numer ostatniego obsłużonego żądania procesu j
+    int* queue;        // Kolejka FIFO (bufor cykliczny) procesów czekających na token
+    bool* in_queue;    // Czy proces j jest już w kolejce (sprawdzenie w O(1))
+    int queue_head;    // Indeks pierwszego elementu kolejki
+    int queue_size;    // Liczba procesów w kolejce
+} Token;
+
+// Prosta funkcja zwracająca większą z dwóch liczb.
+int max(int a, int b) {
+    return a > b ? a : b;
+}
+
+// Funkcja pomocnicza do zwracania nazwy typu wiadomości jako string (dla logowania).
+const char* get_message_type_name(MessageType type) {
+    switch (type) {
+        case MSG_REQ: return "ŻĄDANIE TOKENU (REQ)";
+        case MSG_TOKEN: return "TOKEN (TOKEN)";
+        case MSG_TERMINATE: return "ZAKOŃCZENIE PRACY (TERMINATE)";
+        default: return "NIEZNANY TYP";
+    }
+}
+
+// Inicjalizuje pusty token (LN = 0, pusta kolejka).
+void token_init(Token* token, int num_procs) {
+    token->last_served = malloc(num_procs * sizeof(int));
+    token->queue = malloc(num_procs * sizeof(int));
+    token->in_queue = malloc(num_procs * sizeof(bool));
+    for (int i = 0; i < num_procs; i++) {
+        token->last_served[i] = 0;
+        token->in_queue[i] = false;
+    }
+    token->queue_head = 0;
+    token->queue_size = 0;
+}
+
+// Zwalnia pamięć tokenu.
+void token_free(Token* token) {
+    free(token->last_served);
+    free(token->queue);
+    free(token->in_queue);
+}
+
+// Dopisuje proces na koniec kolejki tokenu (jeśli jeszcze go tam nie ma).
+void token_enqueue(Token* token, int rank, int num_procs) {
+    if (token->in_queue[rank]) return;
+    token->queue[(token->queue_head + token->queue_size) % num_procs] = rank;
+    token->queue_size++;
+    token->in_queue[rank] = true;
+}
+
+// Zdejmuje proces z początku kolejki tokenu.
+int token_dequeue(Token* token, int num_procs) {
+    int rank = token->queue[token->queue_head];
+    token->queue_head = (token->queue_head + 1) % num_procs;
+    token->queue_size--;
+    token->in_queue[rank] = false;
+    return rank;
+}
+
+// Wysyła token do procesu target: nagłówek MSG_TOKEN, a po nim tablicę LN i kolejkę Q (tag TOKEN_TAG).
+// stats == NULL: wiadomość poza pomiarem.
+void token_send(Token* token, int target, int clock, int my_rank, int num_procs, BenchStats* stats, Trace* trace) {
+    int payload[2 * num_procs + 1];
+    for (int i = 0; i < num_procs; i++) {
+        payload[i] = token->last_served[i];
+    }
+    payload[num_procs] = token->queue_size;
+    for (int i = 0; i < token->queue_size; i++) {
+        payload[num_procs + 1 + i] = token->queue[(token->queue_head + i) % num_procs];
+    }
+
+    Message msg_out_token = {MSG_TOKEN, clock, my_rank, 0};
+    MPI_Send(&msg_out_token, sizeof(Message), MPI_BYTE, target, 0, MPI_COMM_WORLD);
+    MPI_Send(payload, num_procs + 1 + token->queue_size, MPI_INT, target, TOKEN_TAG, MPI_COMM_WORLD);
+    bench_message_sent(stats, MSG_TOKEN, 0);
+    trace_event(trace, TRACE_SEND, clock, target, MSG_TOKEN, -1);
+}
+
+// Odbiera zawartość tokenu od procesu source (po odebraniu nagłówka MSG_TOKEN).
+void token_receive(Token* token, int source, int num_procs) {
+    int payload[2 * num_procs + 1];
+    MPI_Recv(payload, 2 * num_procs + 1, MPI_INT, source, TOKEN_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+    for (int i = 0; i < num_procs; i++) {
+        token->last_served[i] = payload[i];
+        token->in_queue[i] = false;
+    }
+    token->queue_head = 0;
+    token->queue_size = 0;
+    for (int i = 0; i < payload[num_procs]; i++) {
+        token_enqueue(token, payload[num_procs + 1 + i], num_procs);
+    }
+}
+
+// Przetwarza odebraną wiadomość: aktualizuje zegar, tablicę RN, kolejkę tokenu i licznik aktywnych procesów.
+void process_message(Message msg_in, int* clock, int request_numbers[], Token* token, bool* has_token,
+                     int* active_procs, int my_rank, int num_procs, BenchStats* stats, Trace* trace) {
+    // Aktualizacja zegara Lamporta na podstawie odebranej wiadomości
+    *clock = max(*clock, msg_in.timestamp) + 1;
+    bench_message_received(stats, msg_in.type, 0);
+    trace_event(trace, TRACE_RECV, *clock, msg_in.sender_rank, msg_in.type, -1);
+    LOG(2, "--- Proces %d --- [Zegar: %d] Odebrałem wiadomość: **%s** od procesu %d (ts=%d).\n", my_rank, *clock, get_message_type_name(msg_in.type), msg_in.sender_rank, msg_in.timestamp);
+
+    if (msg_in.type == MSG_REQ) { // Żądanie tokenu od innego procesu
+        request_numbers[msg_in.sender_rank] = max(request_numbers[msg_in.sender_rank], msg_in.request_number);
+        // Jeśli trzymam token, a żądanie jest nowe (RN[j] == LN[j] + 1), proces trafia do kolejki tokenu
+        if (*has_token && request_numbers[msg_in.sender_rank] == token->last_served[msg_in.sender_rank] + 1) {
+            token_enqueue(token, msg_in.sender_rank, num_procs);
+        }
+    } else if (msg_in.type == MSG_TOKEN) { // Otrzymałem token
+        token_receive(token, msg_in.sender_rank, num_procs);
+        *has_token = true;
+    } else if (msg_in.type == MSG_TERMINATE) { // Wiadomość o zakończeniu pracy od innego procesu
+        (*active_procs)--;
+    }
+}
+
+// Jeśli posiadam token poza sekcją krytyczną, a w jego kolejce ktoś czeka - przekazuję token pierwszemu z kolejki.
+void pass_token_if_requested(Token* token, bool* has_token, int* clock, int my_rank, int num_procs,
+                             BenchStats* stats, Trace* trace) {
+    if (!*has_token || token->queue_size == 0) return;
+
+    (*clock)++; // Zdarzenie lokalne: wysłanie tokenu
+    int target_rank = token_dequeue(token, num_procs);
+    token_send(token, target_rank, *clock, my_rank, num_procs, stats, trace);
+    *has_token = false;
+    LOG(2, "--- Proces %d --- [Zegar: %d] Wysłałem **%s** do procesu %d.\n", my_rank, *clock, get_message_type_name(MSG_TOKEN), target_rank);
+}
+
+int main(int argc, char* argv[]) {
+    int my_rank, num_procs; // Ranga bieżącego procesu i całkowita liczba procesów
+    MPI_Init(&argc, &argv); // Inicjalizacja środowiska MPI
+    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);    // Pobranie rangi bieżącego procesu
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);  // Pobranie całkowitej liczby procesów
+
+    int clock = 0; // Zegar Lamporta dla bieżącego procesu (tylko do logowania)
+
+    Workload workload; // Parametry obciążenia (linia poleceń / zmienne środowiskowe)
+    workload_init(&workload, argc, argv, NUM_OPERATIONS, NUM_HOUSES_TOTAL, 1);
+    BenchStats stats; // Pomiary benchmarku
+    bench_init(&stats, workload.operations);
+
+    // Ślad zdarzeń (zapisywany tylko przy --trace-dir / TRACE_DIR)
+    const char* message_names[MSG_TERMINATE + 1];
+    for (int t = 0; t <= MSG_TERMINATE; t++) message_names[t] = get_message_type_name(t);
+    Trace trace;
+    trace_init(&trace, argc, argv, "suzuki_kasami", my_rank, num_procs, message_names, MSG_TERMINATE + 1);
+    static Metrics metrics; // Rejestr metryk (liczniki zawsze, migawki przy --metrics-ms / BENCH_METRICS_MS)
+    metrics_init(&metrics, argc, argv, "suzuki_kasami", my_rank, num_procs, message_names, MSG_TERMINATE + 1, 0);
+    stats.metrics = &metrics;
+
+    // Stan algorytmu Suzuki-Kasami
+    int request_numbers[num_procs]; // RN[j]: najwyższy znany numer żądania procesu j
+    for (int i = 0; i < num_procs; i++) {
+        request_numbers[i] = 0;
+    }
+    Token token; // Token (ważny tylko wtedy, gdy has_token == true)
+    token_init(&token, num_procs);
+    bool has_token = (my_rank == TOKEN_HOLDER_AT_START); // Czy posiadam token
+    int active_procs = num_procs - 1; // Liczba innych procesów, które jeszcze nie zakończyły pracy
+
+    RecvEngine recv_engine; // Silnik odbioru wiadomości (stałe żądania odbioru)
+    recv_engine_init(&recv_engine, sizeof(Message), MPI_COMM_WORLD);
+
+    // Inicjalizacja generatora liczb losowych (stałe ziarno daje powtarzalne obciążenie)
+    srand(workload.seed >= 0 ? (unsigned)(workload.seed + my_rank) : (unsigned)(my_rank * time(NULL)));
+
+    bench_start(&stats); // Wspólny początek pomiaru
+    metrics_start(&metrics);
+
+    // Główna pętla symulująca operacje kradzieży
+    for (int op_count = 0; op_count < workload.operations; op_count++) {
+        // --- PRÓBA WEJŚCIA DO SEKCJI KRYTYCZNEJ ---
+        LOG(1, "--- Proces %d --- [Zegar: %d] Rozpoczynam Operację #%d: Próba kradzieży. Zwiększam zegar.\n", my_rank, clock, op_count + 1);
+        clock++; // Zdarzenie lokalne: inkrementacja zegara Lamporta
+        int target_house_id = (my_rank + op_count) % workload.houses; // Symboliczny wybór domu do okradzenia
+        bench_request(&stats, 0, false); // Jedna sekcja krytyczna (jeden token) dla wszystkich domów
+        trace_event(&trace, TRACE_CS_REQUEST, clock, -1, -1, target_house_id);
+
+        // Obsługa wiadomości, które przyszły w czasie odpoczynku; bezczynny token oddaję oczekującym
+        Message msg_in;
+        while (recv_engine_try_next(&recv_engine, &msg_in)) {
+            process_message(msg_in, &clock, request_numbers, &token, &has_token, &active_procs, my_rank, num_procs, &stats, &trace);
+        }
+        pass_token_if_requested(&token, &has_token, &clock, my_rank, num_procs, &stats, &trace);
+
+        if (!has_token) {
+            // Nie mam tokenu: rozsyłam żądanie z nowym numerem (N-1 wiadomości) i czekam na token (1 wiadomość).
+            // Jeśli token jest u mnie, wchodzę bez wysyłania jakichkolwiek wiadomości.
+            clock++; // Zdarzenie lokalne: wysłanie żądania
+            request_numbers[my_rank]++;
+            Message msg_out_req = {MSG_REQ, clock, my_rank, request_numbers[my_rank]};
+            for (int i = 0; i < num_procs; i++) {
+                if (i != my_rank) {
+                    MPI_Send(&msg_out_req, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD);
+                    bench_message_sent(&stats, MSG_REQ, 0);
+                    trace_event(&trace, TRACE_SEND, clock, i, MSG_REQ, -1);
+                }
+            }
+            LOG(2, "--- Proces %d --- [Zegar: %d] Wysłałem **%s** (RN=%d) do wszystkich.\n", my_rank, clock, get_message_type_name(MSG_REQ), request_numbers[my_rank]);
+
+            // Pętla oczekiwania na token
+            while (!has_token) {
+                recv_engine_next(&recv_engine, &msg_in); // Krótkie aktywne oczekiwanie, potem blokowanie
+                process_message(msg_in, &clock, request_numbers, &token, &has_token, &active_procs, my_rank, num_procs, &stats, &trace);
+            }
+        }
+
+        // --- WEJŚCIE DO SEKCJI KRYTYCZNEJ ---
+        clock++; // Zdarzenie lokalne: inkrementacja zegara
+        bench_enter(&stats);
+        trace_event(&trace, TRACE_CS_ENTER, clock, -1, -1, target_house_id);
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WSZEDŁEM DO SEKCJI KRYTYCZNEJ KRADZIEŻY! *** Okradam dom o symbolicznym ID: %d.\n", my_rank, clock, target_house_id);
+
+        usleep(workload_random_us(workload.cs_min_us, workload.cs_max_us)); // Symulacja czasu trwania kradzieży
+
+        // --- WYJŚCIE Z SEKCJI KRYTYCZNEJ ---
+        clock++; // Zdarzenie lokalne: inkrementacja zegara
+        bench_exit(&stats);
+        trace_event(&trace, TRACE_CS_EXIT, clock, -1, -1, target_house_id);
+        token.last_served[my_rank] = request_numbers[my_rank]; // LN[i] = RN[i]: moje żądanie zostało obsłużone
+
+        // Dopisanie do kolejki tokenu wszystkich procesów z nieobsłużonym żądaniem (RN[j] == LN[j] + 1)
+        for (int i = 0; i < num_procs; i++) {
+            if (i != my_rank && request_numbers[i] == token.last_served[i] + 1) {
+                token_enqueue(&token, i, num_procs);
+            }
+        }
+        LOG(1, "--- Proces %d --- [Zegar: %d] *** WYSZEDŁEM Z SEKCJI KRYTYCZNEJ KRADZIEŻY. *** Przekazuję token oczekującym.\n", my_rank, clock);
+
+        // Obsłużenie żądań, które przyszły w czasie sekcji krytycznej, i przekazanie tokenu
+        while (recv_engine_try_next(&recv_engine, &msg_in)) {
+            process_message(msg_in, &clock, request_numbers, &token, &has_token, &active_procs, my_rank, num_procs, &stats, &trace);
+        }
+        pass_token_if_requested(&token, &has_token, &clock, my_rank, num_procs, &stats, &trace);
+
+        LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem Operację #%d. Odpoczywam przed kolejną próbą.\n", my_rank, clock, op_count + 1);
+        trace_flush(&trace); // Zrzut śladu poza sekcją krytyczną i pętlą oczekiwania
+        metrics_tick(&metrics, clock); // Migawki za minione okresy
+        usleep(workload_random_us(workload.think_min_us, workload.think_max_us)); // Symulacja odpoczynku
+    }
+    bench_finish(&stats); // Koniec pomiaru - dalsze wiadomości (TERMINATE, obsługa innych) są poza nim
+
+    // Po zakończeniu wszystkich operacji, proces informuje inne procesy o swoim zakończeniu
+    trace_event(&trace, TRACE_FINISH, clock, -1, -1, -1);
+    Message msg_terminate = {MSG_TERMINATE, clock, my_rank, 0}; // Przygotuj wiadomość o zakończeniu
+    for (int i = 0; i < num_procs; i++) {
+        if (i != my_rank) {
+            MPI_Send(&msg_terminate, sizeof(Message), MPI_BYTE, i, 0, MPI_COMM_WORLD); // Wyślij do innych
+            trace_event(&trace, TRACE_SEND, clock, i, MSG_TERMINATE, -1);
+        }
+    }
+    LOG(1, "--- Proces %d --- [Zegar: %d] Zakończyłem wszystkie zaplanowane operacje kradzieży. Obsługuję żądania, dopóki inni pracują.\n", my_rank, clock);
+
+    // Token nie może zniknąć razem z procesem: dopóki inne procesy pracują, obsługuję ich żądania
+    // i przekazuję token, jeśli go posiadam.
+    pass_token_if_requested(&token, &has_token, &clock, my_rank, num_procs, NULL, &trace);
+    while (active_procs > 0) {
+        Message msg_in;
+        recv_engine_next(&recv_engine, &msg_in);
+        process_message(msg_in, &clock, request_numbers, &token, &has_token, &active_procs, my_rank, num_procs, &stats, &trace);
+        pass_token_if_requested(&token, &has_token, &clock, my_rank, num_procs, NULL, &trace);
+    }
+    LOG(1, "--- Proces %d --- [Zegar: %d] Wszystkie procesy zakończyły pracę. Finalizuję pracę.\n", my_rank, clock);
+
+    MPI_Barrier(MPI_COMM_WORLD); // Bariera, aby upewnić się, że wszystkie procesy doszły do tego punktu przed finalizacją
+    metrics_finish(&metrics, clock); // Migawka końcowa (operacja zbiorowa)
+    bench_report(&stats, &workload, "suzuki_kasami", my_rank, num_procs); // Raport benchmarku (proces 0; operacja zbiorowa)
+    bench_free(&stats);
+    metrics_free(&metrics);
+    trace_close(&trace); // Zrzut reszty śladu przed MPI_Finalize
+    recv_engine_free(&recv_engine); // Zwolnienie stałych żądań odbioru
+    token_free(&token);
+    MPI_Finalize(); // Zakończenie pracy środowiska MPI
+    return 0;
+}
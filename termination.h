@@ -0,0 +1,48 @@
+// Wykrywanie zakończenia bez rozgłaszania TERMINATE (wspólne dla nowa.c, na3.c i mpi.c).
+//  1. Proces, który wykonał wszystkie swoje operacje, wchodzi do MPI_Ibarrier i dalej obsługuje
+//     wiadomości (inni mogą jeszcze potrzebować jego zgody albo tokenu). Bariera kończy się, gdy
+//     skończyli wszyscy - w O(log N) krokach, bez N^2 wiadomości.
+//  2. Po barierze nikt już o nic nie prosi, ale w sieci mogą być jeszcze wiadomości (np. ostatnie
+//     zwolnienia). Każdy proces liczy, ile wiadomości wysłał do każdego innego; MPI_Reduce_scatter_block
+//     daje każdemu sumę wiadomości zaadresowanych do niego. Proces odbiera resztę (bez obsługi),
+//     aż liczba odebranych się zgodzi - do MPI_Finalize nie zostaje żadna niedoręczona wiadomość.
+#ifndef TERMINATION_H
+#define TERMINATION_H
+
+#include <mpi.h>
+#include <stdlib.h>
+
+typedef struct {
+    long* sent_to;        // sent_to[j]: liczba wiadomości wysłanych do procesu j
+    MPI_Request barrier;  // MPI_Ibarrier "wszyscy skończyli operacje" (MPI_REQUEST_NULL przed startem)
+    int num_procs;
+} Termination;
+
+static inline void termination_init(Termination* termination, int num_procs) {
+    termination->sent_to = calloc(num_procs, sizeof(long));
+    termination->barrier = MPI_REQUEST_NULL;
+    termination->num_procs = num_procs;
+}
+
+// Zapamiętuje wysłanie jednej wiadomości do procesu target.
+static inline void termination_count_send(Termination* termination, int target) {
+    termination->sent_to[target]++;
+}
+
+// Zgłasza koniec własnych operacji (nie blokuje).
+static inline void termination_start(Termination* termination) {
+    MPI_Ibarrier(MPI_COMM_WORLD, &termination->barrier);
+}
+
+// Po zakończeniu bariery: liczba wiadomości, które wysłano do mnie od początku pracy (operacja zbiorowa).
+static inline long termination_expected(Termination* termination) {
+    long expected = 0;
+    MPI_Reduce_scatter_block(termination->sent_to, &expected, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    return expected;
+}
+
+static inline void termination_free(Termination* termination) {
+    free(termination->sent_to);
+}
+
+#endif
@@ -0,0 +1,193 @@
+// Binarny ślad zdarzeń procesu (zamiast printf na gorącej ścieżce).
+// Każdy proces zapisuje rekordy stałej wielkości (zdarzenie, zegar Lamporta, czas ścienny, partner)
+// do wstępnie zaalokowanego bufora pierścieniowego. Bufor jest zrzucany do pliku <katalog>/trace.<ranga>.bin
+// poza sekcją krytyczną i pętlą oczekiwania (trace_flush w czasie odpoczynku) oraz przed MPI_Finalize.
+// Gdy bufor się zapełni przed zrzutem, najstarsze rekordy są nadpisywane, a w pliku pojawia się
+// rekord TRACE_DROPPED z liczbą utraconych zdarzeń. Pliki wszystkich procesów łączy w porządku
+// Lamporta narzędzie trace_merge.c.
+//
+// Ślad jest zapisywany tylko, gdy podano katalog (--trace-dir=KATALOG lub TRACE_DIR=KATALOG).
+// Czytelne logi printf są włączane w czasie kompilacji: -DLOG_LEVEL=1 (operacje i sekcje krytyczne)
+// albo -DLOG_LEVEL=2 (dodatkowo każda odebrana wiadomość). Domyślnie LOG_LEVEL=0 - bez logów.
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifndef TRACE_NO_MPI // trace_merge.c potrzebuje tylko formatu rekordów, sim.c - tylko LOG
+#include <mpi.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "walltime.h"
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL 0
+#endif
+
+#ifndef TRACE_CAPACITY
+#define TRACE_CAPACITY 4096 // Liczba rekordów w buforze pierścieniowym
+#endif
+
+#define TRACE_MAX_MSG_TYPES 16
+#define TRACE_NAME_LEN 32
+#define TRACE_MAGIC "LMTRACE1"
+
+// Czytelny log na poziomie level (usuwany przez kompilator, gdy LOG_LEVEL < level)
+#define LOG(level, ...) do { if (LOG_LEVEL >= (level)) printf(__VA_ARGS__); } while (0)
+
+// Rodzaje zdarzeń
+typedef enum {
+    TRACE_SEND,           // Wysłanie wiadomości do partnera
+    TRACE_RECV,           // Odebranie wiadomości od partnera (zegar po aktualizacji)
+    TRACE_CS_REQUEST,     // Żądanie sekcji krytycznej kradzieży (resource = dom)
+    TRACE_CS_ENTER,       // Wejście do sekcji krytycznej kradzieży
+    TRACE_CS_EXIT,        // Wyjście z sekcji krytycznej kradzieży
+    TRACE_FENCE_REQUEST,  // Żądanie pasera
+    TRACE_FENCE_ENTER,    // Wejście do sekcji pasera
+    TRACE_FENCE_EXIT,     // Wyjście z sekcji pasera
+    TRACE_FINISH,         // Koniec wszystkich operacji procesu
+    TRACE_DROPPED,        // Utracone rekordy (peer = liczba nadpisanych rekordów)
+    TRACE_READ_ENTER,     // Wejście do sekcji kradzieży w trybie współdzielonym (oględziny domu)
+    TRACE_READ_EXIT,      // Wyjście z sekcji w trybie współdzielonym
+    TRACE_EVENT_COUNT
+} TraceEvent;
+
+// Rekord śladu (stała wielkość, zapisywany binarnie)
+typedef struct {
+    double wall_time;  // Czas ścienny (wall_time(), porównywalny między procesami)
+    int32_t clock;     // Zegar Lamporta procesu (dla TRACE_SEND: znacznik czasu wiadomości)
+    int32_t peer;      // Ranga partnera (-1 gdy brak)
+    int16_t rank;      // Ranga procesu zapisującego
+    int16_t resource;  // Dom (-1 gdy nie dotyczy)
+    uint8_t event;     // TraceEvent
+    uint8_t msg_type;  // Typ wiadomości programu (0xff gdy nie dotyczy)
+    uint8_t pad[2];
+} TraceRecord;
+
+// Nagłówek pliku śladu (opisuje program i nazwy typów jego wiadomości)
+typedef struct {
+    char magic[8];
+    char program[TRACE_NAME_LEN];
+    int32_t rank;
+    int32_t num_procs;
+    int32_t msg_type_count;
+    char msg_type_names[TRACE_MAX_MSG_TYPES][TRACE_NAME_LEN];
+} TraceFileHeader;
+
+#ifndef TRACE_NO_MPI
+
+// Stan śladu procesu
+typedef struct Trace {
+    TraceRecord records[TRACE_CAPACITY]; // Bufor pierścieniowy
+    int head;         // Indeks najstarszego niezrzuconego rekordu
+    int count;        // Liczba niezrzuconych rekordów
+    long dropped;     // Rekordy nadpisane od ostatniego zrzutu
+    int rank;
+    FILE* file;       // NULL = ślad wyłączony
+} Trace;
+
+// Otwiera plik śladu (jeśli podano katalog) i zapisuje nagłówek.
+// msg_type_names[i] to nazwa typu wiadomości o wartości i.
+// Kopiuje nazwę do pola nagłówka (TRACE_NAME_LEN bajtów z zerem). Nazwy są po polsku, więc przycięcie
+// cofa się do granicy znaku UTF-8 - bajt kontynuacji (10xxxxxx) nie może zacząć ucięcia.
+static void trace_copy_name(char* out, const char* name) {
+    size_t len = strlen(name);
+    if (len > TRACE_NAME_LEN - 1) {
+        len = TRACE_NAME_LEN - 1;
+        while (len > 0 && ((unsigned char)name[len] & 0xC0) == 0x80) len--;
+    }
+    memcpy(out, name, len);
+    out[len] = '\0';
+}
+
+static void trace_init(Trace* trace, int argc, char** argv, const char* program, int rank, int num_procs,
+                       const char* const* msg_type_names, int msg_type_count) {
+    trace->head = 0;
+    trace->count = 0;
+    trace->dropped = 0;
+    trace->rank = rank;
+    trace->file = NULL;
+
+    const char* dir = getenv("TRACE_DIR");
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--trace-dir=", 12) == 0) dir = argv[i] + 12;
+    }
+    if (!dir || !dir[0]) return;
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/trace.%d.bin", dir, rank);
+    trace->file = fopen(path, "wb");
+    if (!trace->file) {
+        fprintf(stderr, "Proces %d: nie mogę otworzyć pliku śladu %s\n", rank, path);
+        return;
+    }
+
+    TraceFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    trace_copy_name(header.program, program);
+    header.rank = rank;
+    header.num_procs = num_procs;
+    header.msg_type_count = msg_type_count < TRACE_MAX_MSG_TYPES ? msg_type_count : TRACE_MAX_MSG_TYPES;
+    for (int i = 0; i < header.msg_type_count; i++) {
+        trace_copy_name(header.msg_type_names[i], msg_type_names[i]);
+    }
+    fwrite(&header, sizeof(header), 1, trace->file);
+}
+
+// Dopisuje zdarzenie do bufora (tylko zapis do pamięci - bez wywołań systemowych).
+static void trace_event(Trace* trace, TraceEvent event, int clock, int peer, int msg_type, int resource) {
+    if (!trace->file) return;
+    if (trace->count == TRACE_CAPACITY) { // Bufor pełny - nadpisz najstarszy rekord
+        trace->head = (trace->head + 1) % TRACE_CAPACITY;
+        trace->count--;
+        trace->dropped++;
+    }
+    TraceRecord* rec = &trace->records[(trace->head + trace->count) % TRACE_CAPACITY];
+    rec->wall_time = wall_time();
+    rec->clock = clock;
+    rec->peer = peer;
+    rec->rank = (int16_t)trace->rank;
+    rec->resource = (int16_t)resource;
+    rec->event = (uint8_t)event;
+    rec->msg_type = msg_type < 0 ? 0xff : (uint8_t)msg_type;
+    rec->pad[0] = rec->pad[1] = 0;
+    trace->count++;
+}
+
+// Zrzuca bufor do pliku. Wywoływać poza gorącą ścieżką (np. w czasie odpoczynku między operacjami).
+static void trace_flush(Trace* trace) {
+    if (!trace->file) return;
+    if (trace->dropped > 0) {
+        TraceRecord rec = {wall_time(), trace->records[trace->head].clock, (int32_t)trace->dropped,
+                           (int16_t)trace->rank, -1, TRACE_DROPPED, 0xff, {0, 0}};
+        fwrite(&rec, sizeof(rec), 1, trace->file);
+        trace->dropped = 0;
+    }
+    int first = trace->count < TRACE_CAPACITY - trace->head ? trace->count : TRACE_CAPACITY - trace->head;
+    fwrite(&trace->records[trace->head], sizeof(TraceRecord), first, trace->file);
+    fwrite(&trace->records[0], sizeof(TraceRecord), trace->count - first, trace->file);
+    trace->head = 0;
+    trace->count = 0;
+}
+
+// Zrzuca resztę bufora i zamyka plik (przed MPI_Finalize).
+static void trace_close(Trace* trace) {
+    if (!trace->file) return;
+    trace_flush(trace);
+    fclose(trace->file);
+    trace->file = NULL;
+}
+
+#else
+// Bez MPI (symulator sim.c przez lockset.h) śladu nie ma: wspólny kod protokołów wywołuje trace_event
+// z pustym śladem i nic się nie zapisuje.
+typedef struct Trace Trace;
+
+static inline void trace_event(Trace* trace, TraceEvent event, int clock, int peer, int msg_type, int resource) {
+    (void)trace; (void)event; (void)clock; (void)peer; (void)msg_type; (void)resource;
+}
+#endif // TRACE_NO_MPI
+
+#endif
@@ -0,0 +1,107 @@
+// Narzędzie offline: łączy binarne ślady procesów (trace.<ranga>.bin, zob. trace.h)
+// w jeden czytelny przebieg uporządkowany według zegara Lamporta.
+// Przy równych zegarach kolejność rozstrzyga ranga, a w obrębie procesu kolejność zapisu.
+//
+// Kompilacja: gcc -O2 -o trace_merge trace_merge.c
+// Użycie:     ./trace_merge KATALOG/trace.*.bin
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Potrzebne są tylko definicje rekordów i nagłówka, bez MPI
+#define TRACE_NO_MPI
+#include "trace.h"
+
+// Nazwa rodzaju zdarzenia (TraceEvent) do wydruku
+const char* trace_event_name(int event) {
+    const char* names[TRACE_EVENT_COUNT] = {
+        "SEND", "RECV", "CS_REQUEST", "CS_ENTER", "CS_EXIT",
+        "FENCE_REQUEST", "FENCE_ENTER", "FENCE_EXIT", "FINISH", "DROPPED",
+        "READ_ENTER", "READ_EXIT"
+    };
+    return (event >= 0 && event < TRACE_EVENT_COUNT) ? names[event] : "?";
+}
+
+// Rekord wraz z miejscem w pliku źródłowym (do stabilnego sortowania)
+typedef struct {
+    TraceRecord rec;
+    int file_index;
+    long seq;
+} MergedRecord;
+
+int compare_merged(const void* a, const void* b) {
+    const MergedRecord* x = a;
+    const MergedRecord* y = b;
+    if (x->rec.clock != y->rec.clock) return x->rec.clock < y->rec.clock ? -1 : 1;
+    if (x->rec.rank != y->rec.rank) return x->rec.rank < y->rec.rank ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Użycie: %s trace.0.bin [trace.1.bin ...]\n", argv[0]);
+        return 1;
+    }
+
+    int num_files = argc - 1;
+    TraceFileHeader* headers = calloc(num_files, sizeof(TraceFileHeader));
+    MergedRecord* all = NULL;
+    long total = 0, capacity = 0;
+    double start_time = 0.0;
+    int have_start = 0;
+
+    for (int f = 0; f < num_files; f++) {
+        FILE* file = fopen(argv[f + 1], "rb");
+        if (!file) {
+            fprintf(stderr, "Nie mogę otworzyć %s\n", argv[f + 1]);
+            return 1;
+        }
+        if (fread(&headers[f], sizeof(TraceFileHeader), 1, file) != 1 ||
+            memcmp(headers[f].magic, TRACE_MAGIC, sizeof(headers[f].magic)) != 0) {
+            fprintf(stderr, "%s: to nie jest plik śladu\n", argv[f + 1]);
+            return 1;
+        }
+
+        TraceRecord rec;
+        long seq = 0;
+        while (fread(&rec, sizeof(rec), 1, file) == 1) {
+            if (total == capacity) {
+                capacity = capacity ? 2 * capacity : 1024;
+                all = realloc(all, capacity * sizeof(MergedRecord));
+            }
+            all[total].rec = rec;
+            all[total].file_index = f;
+            all[total].seq = seq++;
+            total++;
+            if (!have_start || rec.wall_time < start_time) {
+                start_time = rec.wall_time;
+                have_start = 1;
+            }
+        }
+        fclose(file);
+    }
+
+    qsort(all, total, sizeof(MergedRecord), compare_merged);
+
+    printf("# %s, procesy: %d, rekordy: %ld\n", num_files > 0 ? headers[0].program : "", headers[0].num_procs, total);
+    printf("# zegar  proces      czas[ms]  zdarzenie       partner  dom  wiadomość\n");
+    for (long i = 0; i < total; i++) {
+        const TraceRecord* rec = &all[i].rec;
+        const TraceFileHeader* header = &headers[all[i].file_index];
+        const char* msg_name = "-";
+        if (rec->msg_type != 0xff && rec->msg_type < header->msg_type_count) {
+            msg_name = header->msg_type_names[rec->msg_type];
+        }
+        char peer[16], resource[16];
+        snprintf(peer, sizeof(peer), "%d", rec->peer);
+        snprintf(resource, sizeof(resource), "%d", rec->resource);
+        printf("%7d  %6d  %12.3f  %-14s  %7s  %3s  %s\n",
+               rec->clock, rec->rank, 1000.0 * (rec->wall_time - start_time), trace_event_name(rec->event),
+               rec->peer >= 0 ? peer : "-", rec->resource >= 0 ? resource : "-", msg_name);
+    }
+
+    free(all);
+    free(headers);
+    return 0;
+}
@@ -0,0 +1,215 @@
+// Warstwa przesyłania wiadomości MPI wspólna dla wszystkich programów (nagłówki o stałej wielkości,
+// wysyłane jako MPI_BYTE - każdy program ma własną strukturę Message i podaje tu tylko jej rozmiar).
+//   RecvEngine  - odbiór na stałych żądaniach (MPI_Recv_init/MPI_Start) ustawionych w pierścień,
+//   SendPool    - nieblokujące wysyłki (MPI_Isend) paczkami z kopii w slotach,
+//   PayloadPool - ładunki o zmiennej długości (tablice int) osobnym tagiem, też przez MPI_Isend.
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "termination.h"
+
+#ifndef RECV_SLOTS
+#define RECV_SLOTS 8          // Liczba wstępnie zarejestrowanych (persistent) odbiorów wiadomości
+#endif
+#ifndef RECV_SPIN_ITERS
+#define RECV_SPIN_ITERS 1000  // Ile razy sprawdzić odbiór (MPI_Test) przed zablokowaniem się w MPI_Wait (0 = od razu blokuj)
+#endif
+#ifndef SEND_SLOTS
+#define SEND_SLOTS 4          // Ile paczek wiadomości (MPI_Isend) może być jednocześnie w toku
+#endif
+
+// Silnik odbioru. Odbiory są zarejestrowane w pierścieniu w kolejności startu; MPI dopasowuje przychodzące
+// wiadomości do najstarszego zarejestrowanego odbioru, więc czekając zawsze na głowę pierścienia
+// zachowujemy kolejność FIFO wiadomości od każdego nadawcy (wymaganą przez algorytmy).
+typedef struct {
+    char* buffers;                    // RECV_SLOTS buforów po msg_size bajtów
+    MPI_Request requests[RECV_SLOTS]; // Stałe żądania odbioru
+    int msg_size;
+    int head;                         // Indeks najstarszego zarejestrowanego odbioru
+    long received;                    // Liczba odebranych wiadomości (do wykrywania zakończenia)
+} RecvEngine;
+
+// Tworzy i uruchamia wszystkie stałe żądania odbioru wiadomości msg_size bajtów (tag 0) na komunikatorze comm.
+static inline void recv_engine_init(RecvEngine* engine, int msg_size, MPI_Comm comm) {
+    engine->buffers = malloc(RECV_SLOTS * msg_size);
+    engine->msg_size = msg_size;
+    for (int i = 0; i < RECV_SLOTS; i++) {
+        MPI_Recv_init(&engine->buffers[i * msg_size], msg_size, MPI_BYTE, MPI_ANY_SOURCE, 0, comm, &engine->requests[i]);
+        MPI_Start(&engine->requests[i]);
+    }
+    engine->head = 0;
+    engine->received = 0;
+}
+
+// Zabiera wiadomość z głowy pierścienia (odbiór musi być zakończony) i ponownie rejestruje odbiór.
+static inline void recv_engine_pop(RecvEngine* engine, void* msg) {
+    memcpy(msg, &engine->buffers[engine->head * engine->msg_size], engine->msg_size);
+    MPI_Start(&engine->requests[engine->head]); // Ponowne zarejestrowanie odbioru - trafia na koniec pierścienia
+    engine->head = (engine->head + 1) % RECV_SLOTS;
+    engine->received++;
+}
+
+// Odbiera kolejną wiadomość. Najpierw przez RECV_SPIN_ITERS prób sprawdza odbiór bez blokowania
+// (niskie opóźnienie przy szybkim przekazaniu), a potem blokuje się w MPI_Wait zamiast spać w usleep.
+static inline void recv_engine_next(RecvEngine* engine, void* msg) {
+    MPI_Request* request = &engine->requests[engine->head];
+    int flag = 0;
+    for (int spin = 0; spin < RECV_SPIN_ITERS && !flag; spin++) {
+        MPI_Test(request, &flag, MPI_STATUS_IGNORE);
+    }
+    if (!flag) {
+        MPI_Wait(request, MPI_STATUS_IGNORE);
+    }
+    recv_engine_pop(engine, msg);
+}
+
+// Bez czekania: true z wiadomością w msg albo false, gdy nic jeszcze nie przyszło.
+static inline bool recv_engine_try_next(RecvEngine* engine, void* msg) {
+    int flag = 0;
+    MPI_Test(&engine->requests[engine->head], &flag, MPI_STATUS_IGNORE);
+    if (!flag) return false;
+    recv_engine_pop(engine, msg);
+    return true;
+}
+
+// Czeka na wiadomość albo na zakończenie żądania *done (bariery zakończenia), co nastąpi wcześniej.
+// Zwraca true z wiadomością w msg albo false, gdy *done się zakończyło (także wcześniej - MPI_REQUEST_NULL).
+static inline bool recv_engine_next_or(RecvEngine* engine, MPI_Request* done, void* msg) {
+    if (*done == MPI_REQUEST_NULL) return false;
+    MPI_Request requests[2] = {engine->requests[engine->head], *done};
+    int index;
+    MPI_Waitany(2, requests, &index, MPI_STATUS_IGNORE);
+    *done = requests[1]; // Zakończone żądanie nietrwałe MPI ustawia na MPI_REQUEST_NULL
+    if (index != 0) return false;
+    recv_engine_pop(engine, msg); // Odbiór już zakończony
+    return true;
+}
+
+// Anuluje niewykorzystane odbiory i zwalnia stałe żądania (przed MPI_Finalize).
+static inline void recv_engine_free(RecvEngine* engine) {
+    for (int i = 0; i < RECV_SLOTS; i++) {
+        MPI_Cancel(&engine->requests[i]);
+        MPI_Wait(&engine->requests[i], MPI_STATUS_IGNORE);
+        MPI_Request_free(&engine->requests[i]);
+    }
+    free(engine->buffers);
+}
+
+// Pula nieblokujących wysyłek. Wiadomości jednego kroku protokołu (rozgłoszenie albo odpowiedzi do kilku
+// procesów) trafiają do jednego slotu i są wysyłane przez MPI_Isend, więc nadawca nie czeka na najwolniejszego
+// odbiorcę. Slot jest ponownie używany dopiero po SEND_SLOTS kolejnych paczkach - wtedy MPI_Waitall zwykle
+// od razu wraca. MPI nie pozwala wiadomościom z jednego nadawcy do jednego odbiorcy wyprzedzać się
+// nawzajem, więc kolejność FIFO względem MPI_Send zostaje zachowana.
+typedef struct {
+    char* messages;           // Kopie wiadomości: slot * capacity + k (po msg_size bajtów)
+    MPI_Request* requests;    // Żądania MPI_Isend, układ jak wyżej
+    int counts[SEND_SLOTS];   // Liczba wysyłek w slocie
+    int next;                 // Kolejny slot do zajęcia
+    int msg_size;
+    int capacity;             // Najwięcej wiadomości w jednej paczce
+    MPI_Comm comm;
+    Termination* termination; // Liczniki wysłanych wiadomości (do wykrywania zakończenia; NULL = bez)
+} SendPool;
+
+static inline void send_pool_init(SendPool* pool, int msg_size, int capacity, MPI_Comm comm, Termination* termination) {
+    if (capacity < 1) capacity = 1;
+    pool->messages = malloc(SEND_SLOTS * capacity * msg_size);
+    pool->requests = malloc(SEND_SLOTS * capacity * sizeof(MPI_Request));
+    for (int i = 0; i < SEND_SLOTS; i++) {
+        pool->counts[i] = 0;
+    }
+    pool->next = 0;
+    pool->msg_size = msg_size;
+    pool->capacity = capacity;
+    pool->comm = comm;
+    pool->termination = termination;
+}
+
+// Zajmuje kolejny slot na paczkę wiadomości (czeka, jeśli jego starsze wysyłki jeszcze trwają).
+static inline int send_pool_take(SendPool* pool) {
+    int slot = pool->next;
+    if (pool->counts[slot] > 0) {
+        MPI_Waitall(pool->counts[slot], &pool->requests[slot * pool->capacity], MPI_STATUSES_IGNORE);
+        pool->counts[slot] = 0;
+    }
+    pool->next = (slot + 1) % SEND_SLOTS;
+    return slot;
+}
+
+// Dopisuje do slotu kopię wiadomości dla procesu target i od razu ją wysyła.
+static inline void send_pool_post(SendPool* pool, int slot, const void* msg, int target) {
+    int k = slot * pool->capacity + pool->counts[slot]++;
+    char* copy = &pool->messages[k * pool->msg_size];
+    memcpy(copy, msg, pool->msg_size);
+    MPI_Isend(copy, pool->msg_size, MPI_BYTE, target, 0, pool->comm, &pool->requests[k]);
+    if (pool->termination) termination_count_send(pool->termination, target);
+}
+
+// Czeka na zakończenie wszystkich wysyłek i zwalnia pulę (przed MPI_Finalize).
+static inline void send_pool_free(SendPool* pool) {
+    for (int slot = 0; slot < SEND_SLOTS; slot++) {
+        if (pool->counts[slot] > 0) {
+            MPI_Waitall(pool->counts[slot], &pool->requests[slot * pool->capacity], MPI_STATUSES_IGNORE);
+        }
+    }
+    free(pool->messages);
+    free(pool->requests);
+}
+
+// Ładunki (tablice int osobnym tagiem) przez MPI_Isend z kopii. Nagłówek wiadomości zwykle wychodzi później,
+// a odbiorca wystawia MPI_Recv ładunku dopiero po odebraniu nagłówka - blokujące MPI_Send ładunku powyżej
+// limitu eager zakleszczyłoby się (także dwa procesy oddające sobie nawzajem tokeny).
+// Zakończone wysyłki są zbierane przy następnych, reszta w payload_pool_free.
+typedef struct {
+    int** buffers;
+    MPI_Request* requests;
+    int count, capacity;
+    MPI_Comm comm;
+} PayloadPool;
+
+static inline void payload_pool_init(PayloadPool* pool, MPI_Comm comm) {
+    pool->buffers = NULL;
+    pool->requests = NULL;
+    pool->count = pool->capacity = 0;
+    pool->comm = comm;
+}
+
+static inline void payload_send(PayloadPool* pool, const int* data, int count, int target, int tag) {
+    int kept = 0;
+    for (int i = 0; i < pool->count; i++) {
+        int done = 0;
+        MPI_Test(&pool->requests[i], &done, MPI_STATUS_IGNORE);
+        if (done) {
+            free(pool->buffers[i]);
+        } else {
+            pool->buffers[kept] = pool->buffers[i];
+            pool->requests[kept++] = pool->requests[i];
+        }
+    }
+    pool->count = kept;
+    if (pool->count == pool->capacity) {
+        pool->capacity = pool->capacity ? 2 * pool->capacity : 8;
+        pool->buffers = realloc(pool->buffers, pool->capacity * sizeof(int*));
+        pool->requests = realloc(pool->requests, pool->capacity * sizeof(MPI_Request));
+    }
+    int* buffer = malloc((count > 0 ? count : 1) * sizeof(int));
+    memcpy(buffer, data, count * sizeof(int));
+    MPI_Isend(buffer, count, MPI_INT, target, tag, pool->comm, &pool->requests[pool->count]);
+    pool->buffers[pool->count++] = buffer;
+}
+
+// Po odbiorze wszystkich nagłówków (odbiorcy odbierają wtedy i ładunki).
+static inline void payload_pool_free(PayloadPool* pool) {
+    MPI_Waitall(pool->count, pool->requests, MPI_STATUSES_IGNORE);
+    for (int i = 0; i < pool->count; i++) {
+        free(pool->buffers[i]);
+    }
+    free(pool->buffers);
+    free(pool->requests);
+}
+
+#endif
@@ -0,0 +1,26 @@
+// Czas ścienny porównywalny między procesami (dla bench.h i trace.h).
+// MPI_Wtime w Open MPI liczy czas osobno od startu każdego procesu (MPI_WTIME_IS_GLOBAL = 0),
+// więc nie nadaje się do porównywania chwil z różnych procesów (opóźnienie synchronizacji,
+// scalanie śladów). CLOCK_REALTIME jest wspólny dla procesów jednego węzła, ale między węzłami
+// różni się o błąd synchronizacji NTP/PTP - dlatego wall_time() dodaje przesunięcie względem
+// zegara węzła procesu 0, mierzone na starcie pomiaru (bench_sync_clocks w bench.h).
+#ifndef WALLTIME_H
+#define WALLTIME_H
+
+#include <time.h>
+
+static double wall_time_offset = 0.0; // Zegar węzła procesu 0 minus zegar tego węzła (sekundy)
+
+// Czas CLOCK_REALTIME tego procesu, bez przesunięcia.
+static inline double wall_time_local(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Czas na zegarze procesu 0.
+static inline double wall_time(void) {
+    return wall_time_local() + wall_time_offset;
+}
+
+#endif